@@ -1,4 +1,5 @@
 #include "src/lsm_tree/lsm_tree.hpp"
+#include <iostream>
 
 enum commands {
     PUT,
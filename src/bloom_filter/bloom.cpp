@@ -1,65 +1,209 @@
 #include "bloom.hpp"
+#include "../utils/coding.hpp"
+#include <algorithm>
+#include <cmath>
+#include <immintrin.h>
+#include <stdexcept>
 
 /**
- * Implementation of a Bloom filter using k = 3 hash functions.
- * The Hash functions are taken from https://gist.github.com/badboy/6267743
+ * Implementation of a blocked bloom filter.
+ * The upper 32 bits of the key hash select the block by multiply-shift, the
+ * lower 32 bits are multiplied with one odd salt per probe and the top 9 bits
+ * of each product select one of the 512 bits of the block.
+ * Probing a block is vectorized with AVX2 if the CPU supports it, the scalar
+ * and the vectorized path set and test exactly the same bits.
  */
 
+namespace {
+    const uint32_t SALTS[16] = {
+        0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+        0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+        0x9e3779b1U, 0x85ebca77U, 0xc2b2ae3dU, 0x27d4eb2fU,
+        0x165667b1U, 0xd3a2646dU, 0xfd7046c5U, 0xb55a4f09U,
+    };
 
-bloom_filter::bloom_filter(long length): table(length) {}
+    const uint64_t HASH_SEED{0x8445d61a4e774912ULL};
 
-bloom_filter::~bloom_filter() {
-    ~table;
+    uint32_t bit_position(uint32_t h, uint32_t probe) {
+        return (h * SALTS[probe]) >> 23;
+    }
+
+    /**
+     * MurmurHash64A over little-endian words. Filters are stored in the SSTs,
+     * so the hash has to be the same on every platform and build.
+     */
+    uint64_t murmur_hash64a(const char* data, size_t n) {
+        const uint64_t m{0xc6a4a7935bd1e995ULL};
+        const int r{47};
+        uint64_t h = HASH_SEED ^ (n * m);
+
+        const char* end = data + (n & ~(size_t) 7);
+        for (; data != end; data += 8) {
+            uint64_t k = coding::decode_fixed64(data);
+            k *= m;
+            k ^= k >> r;
+            k *= m;
+            h ^= k;
+            h *= m;
+        }
+
+        auto tail = reinterpret_cast<const uint8_t*>(data);
+        switch (n & 7) {
+            case 7: h ^= (uint64_t) tail[6] << 48; [[fallthrough]];
+            case 6: h ^= (uint64_t) tail[5] << 40; [[fallthrough]];
+            case 5: h ^= (uint64_t) tail[4] << 32; [[fallthrough]];
+            case 4: h ^= (uint64_t) tail[3] << 24; [[fallthrough]];
+            case 3: h ^= (uint64_t) tail[2] << 16; [[fallthrough]];
+            case 2: h ^= (uint64_t) tail[1] << 8; [[fallthrough]];
+            case 1: h ^= (uint64_t) tail[0];
+                    h *= m;
+        }
+
+        h ^= h >> r;
+        h *= m;
+        h ^= h >> r;
+        return h;
+    }
+
+    bool cpu_has_avx2() {
+        static const bool has_avx2 = __builtin_cpu_supports("avx2");
+        return has_avx2;
+    }
+} // namespace
+
+/**
+ * Build a filter over the hashes of all keys of an SST.
+ * The filter gets bits_per_key * number of keys bits rounded up to whole
+ * blocks and the number of probes which minimizes the false positive rate.
+ */
+bloom_filter::bloom_filter(const std::vector<uint64_t>& key_hashes, double bits_per_key) {
+    if (key_hashes.empty() or bits_per_key <= 0) {
+        return;
+    }
+
+    auto num_bits = (uint64_t) std::ceil((double) key_hashes.size() * bits_per_key);
+    uint64_t bits_per_block = WORDS_PER_BLOCK * 32;
+    blocks.resize((num_bits + bits_per_block - 1) / bits_per_block);
+
+    num_probes = (uint32_t) std::lround(bits_per_key * std::log(2.0));
+    num_probes = std::clamp<uint32_t>(num_probes, 1, MAX_PROBES);
+
+    for (uint64_t hash : key_hashes) {
+        block& b = blocks[block_index(hash)];
+        for (uint32_t i = 0; i < num_probes; ++i) {
+            uint32_t pos = bit_position((uint32_t) hash, i);
+            b.words[pos >> 5] |= 1U << (pos & 31);
+        }
+    }
 }
 
-void bloom_filter::set(const std::string& key) {
-    uint64_t k = string_to_uint64(key);
+/**
+ * Restore a filter from its encoded form:
+ * fixed32 number of probes | fixed32 words of all blocks.
+ * The number of probes is capped at MAX_PROBES, the salts end there.
+ */
+bloom_filter::bloom_filter(std::string_view encoded) {
+    if (encoded.size() < 4 or (encoded.size() - 4) % sizeof(block) != 0) {
+        throw std::runtime_error("Bloom filter block is corrupted");
+    }
+
+    num_probes = std::min(coding::decode_fixed32(encoded.data()), MAX_PROBES);
+    blocks.resize((encoded.size() - 4) / sizeof(block));
 
-    table.set(hash_1(k));
-    table.set(hash_2(k));
-    table.set(hash_3(k));
+    const char* ptr = encoded.data() + 4;
+    for (block& b : blocks) {
+        for (uint32_t& word : b.words) {
+            word = coding::decode_fixed32(ptr);
+            ptr += 4;
+        }
+    }
 }
 
-bool bloom_filter::is_set(const std::string& key) const {
-    uint64_t k = string_to_uint64(key);
+bool bloom_filter::is_set(std::string_view key) const {
+    return may_contain(hash(key));
+}
+
+bool bloom_filter::may_contain(uint64_t hash) const {
+    if (blocks.empty()) {
+        return true;
+    }
 
-    return table.test(hash_1(k))
-        && table.test(hash_2(k)) 
-        && table.test(hash_3(k));
+    const block& b = blocks[block_index(hash)];
+    if (cpu_has_avx2()) {
+        return probe_avx2(b, (uint32_t) hash, num_probes);
+    }
+    return probe_scalar(b, (uint32_t) hash, num_probes);
 }
 
-uint64_t bloom_filter::string_to_uint64(const std::string& key) const {
-    return hasher(key);
+/**
+ * Start loading the block of @param hash into the cache, so a batch of
+ * probes overlaps its cache misses instead of waiting for one at a time.
+ */
+void bloom_filter::prefetch(uint64_t hash) const {
+    if (not blocks.empty()) {
+        __builtin_prefetch(&blocks[block_index(hash)]);
+    }
+}
+
+std::string bloom_filter::encode() const {
+    std::string dst;
+    dst.reserve(4 + blocks.size() * sizeof(block));
+
+    coding::put_fixed32(dst, num_probes);
+    for (const block& b : blocks) {
+        for (uint32_t word : b.words) {
+            coding::put_fixed32(dst, word);
+        }
+    }
+    return dst;
 }
 
-uint64_t bloom_filter::hash_1(uint64_t key) const {
-    key = ~key + (key<<15);
-    key = key ^ (key>>12);
-    key = key + (key<<2);
-    key = key ^ (key>>4);
-    key = key * 2057;
-    key = key ^ (key>>16);
+uint64_t bloom_filter::memory_usage() const {
+    return blocks.size() * sizeof(block);
+}
 
-    return key % table.size();
+uint64_t bloom_filter::hash(std::string_view key) {
+    return murmur_hash64a(key.data(), key.size());
 }
 
-uint64_t bloom_filter::hash_2(uint64_t key) const {
-    key = (key+0x7ed55d16) + (key<<12);
-    key = (key^0xc761c23c) ^ (key>>19);
-    key = (key+0x165667b1) + (key<<5);
-    key = (key+0xd3a2646c) ^ (key<<9);
-    key = (key+0xfd7046c5) + (key<<3);
-    key = (key^0xb55a4f09) ^ (key>>16);
+size_t bloom_filter::block_index(uint64_t hash) const {
+    return ((hash >> 32) * blocks.size()) >> 32;
+}
 
-    return key % table.size();
+bool bloom_filter::probe_scalar(const block& b, uint32_t h, uint32_t num_probes) {
+    for (uint32_t i = 0; i < num_probes; ++i) {
+        uint32_t pos = bit_position(h, i);
+        if ((b.words[pos >> 5] & (1U << (pos & 31))) == 0) {
+            return false;
+        }
+    }
+    return true;
 }
 
-uint64_t bloom_filter::hash_3(uint64_t key) const {
-    key = (key^61) ^ (key>>16);
-    key = key + (key<<3);
-    key = key ^ (key>>4);
-    key = key * 0x27d4eb2d;
-    key = key ^ (key>>15);
+/**
+ * Compute and test 8 probes at once: multiply the hash with 8 salts, gather
+ * the addressed words of the block and check that no addressed bit is
+ * missing. Lanes beyond num_probes are masked out.
+ */
+__attribute__((target("avx2")))
+bool bloom_filter::probe_avx2(const block& b, uint32_t h, uint32_t num_probes) {
+    const __m256i hash = _mm256_set1_epi32((int) h);
+    const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i probes = _mm256_set1_epi32((int) num_probes);
 
-    return key % table.size();
-}
\ No newline at end of file
+    for (uint32_t base = 0; base < num_probes; base += 8) {
+        __m256i salt = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(SALTS + base));
+        __m256i pos = _mm256_srli_epi32(_mm256_mullo_epi32(hash, salt), 23);
+
+        __m256i word_i = _mm256_srli_epi32(pos, 5);
+        __m256i bit = _mm256_sllv_epi32(_mm256_set1_epi32(1), _mm256_and_si256(pos, _mm256_set1_epi32(31)));
+        __m256i words = _mm256_i32gather_epi32(reinterpret_cast<const int*>(b.words), word_i, 4);
+
+        __m256i active = _mm256_cmpgt_epi32(probes, _mm256_add_epi32(lanes, _mm256_set1_epi32((int) base)));
+        __m256i missing = _mm256_and_si256(_mm256_andnot_si256(words, bit), active);
+        if (not _mm256_testz_si256(missing, missing)) {
+            return false;
+        }
+    }
+    return true;
+}
@@ -2,30 +2,54 @@
 #define BLOOM_H
 
 #include "../utils/types.hpp"
-#include <boost/dynamic_bitset/dynamic_bitset.hpp>
+#include <cstdint>
 #include <string>
-
+#include <string_view>
+#include <vector>
+
+/**
+ * Cache-line blocked bloom filter.
+ * Every key is mapped to a single 64 byte block and all of its probes hit
+ * that block, so a lookup costs at most one cache miss.
+ * A filter without any blocks contains every key.
+ */
 class bloom_filter {
-    boost::dynamic_bitset<> table;
-    std::hash<std::string> hasher;
 
     public:
-        bloom_filter(long length);
+        bloom_filter() = default;
+
+        bloom_filter(const std::vector<uint64_t>& key_hashes, double bits_per_key);
+
+        explicit bloom_filter(std::string_view encoded);
+
+        bool is_set(std::string_view key) const;
 
-        ~bloom_filter();
+        bool may_contain(uint64_t hash) const;
 
-        void set(const std::string& key);
+        void prefetch(uint64_t hash) const;
 
-        bool is_set(const std::string& key) const;
+        std::string encode() const;
+
+        uint64_t memory_usage() const;
+
+        static uint64_t hash(std::string_view key);
 
     private:
-        uint64_t string_to_uint64(const std::string& key) const;
+        static const uint32_t WORDS_PER_BLOCK{16};
+        static const uint32_t MAX_PROBES{16};
+
+        struct alignas(64) block {
+            uint32_t words[WORDS_PER_BLOCK];
+        };
+
+        std::vector<block> blocks;
+        uint32_t num_probes{0};
 
-        uint64_t hash_1(uint64_t key) const;
+        size_t block_index(uint64_t hash) const;
 
-        uint64_t hash_2(uint64_t key) const;
+        static bool probe_scalar(const block& b, uint32_t h, uint32_t num_probes);
 
-        uint64_t hash_3(uint64_t key) const;
+        static bool probe_avx2(const block& b, uint32_t h, uint32_t num_probes);
 };
 
-#endif //BLOOM_H
\ No newline at end of file
+#endif //BLOOM_H
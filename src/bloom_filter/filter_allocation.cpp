@@ -0,0 +1,93 @@
+#include "filter_allocation.hpp"
+#include <cmath>
+
+filter_allocation::filter_allocation(double bits_per_key): fixed_bits_per_key(bits_per_key) {}
+
+/**
+ * Capture the current number of entries of every level together with the
+ * total filter memory budget.
+ */
+filter_allocation::filter_allocation(std::vector<uint64_t> entries_per_level, uint64_t budget_bits, bool skip_last_level)
+        : use_budget(true), entries_per_level(std::move(entries_per_level)),
+          budget_bits(budget_bits), skip_last_level(skip_last_level) {}
+
+/**
+ * Return the bits per key of a new SST with @param num_entries entries on
+ * level @param level_order. The new SST is accounted to its level before
+ * the budget is split.
+ */
+double filter_allocation::bits_per_key(uint32_t level_order, uint64_t num_entries) const {
+    if (not use_budget) {
+        return fixed_bits_per_key;
+    }
+
+    std::vector<uint64_t> entries = entries_per_level;
+    if (entries.size() <= level_order) {
+        entries.resize(level_order + 1, 0);
+    }
+    entries[level_order] += num_entries;
+
+    return optimal_bits_per_key(entries, budget_bits, skip_last_level)[level_order];
+}
+
+/**
+ * Minimize sum(p_i) subject to sum(N_i * ln(1 / p_i)) / ln(2)^2 = M.
+ * The Lagrangian gives p_i = lambda * N_i and therefore
+ *   -ln(lambda) = (M * ln(2)^2 + sum(N_i * ln(N_i))) / sum(N_i).
+ * Levels whose rate would reach 1 get no filter and the budget is split
+ * again over the remaining levels until all rates are below 1.
+ */
+std::vector<double> filter_allocation::optimal_bits_per_key(
+        const std::vector<uint64_t>& entries_per_level, uint64_t budget_bits, bool skip_last_level) {
+
+    const double ln2_squared = std::log(2.0) * std::log(2.0);
+    std::vector<double> result(entries_per_level.size(), 0);
+    std::vector<bool> active(entries_per_level.size(), false);
+
+    size_t last_level = entries_per_level.size();
+    for (size_t i = 0; i < entries_per_level.size(); ++i) {
+        active[i] = entries_per_level[i] > 0;
+        if (active[i]) {
+            last_level = i;
+        }
+    }
+    if (skip_last_level and last_level < entries_per_level.size()) {
+        active[last_level] = false;
+    }
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        double sum_entries{0};
+        double sum_entries_log{0};
+        for (size_t i = 0; i < entries_per_level.size(); ++i) {
+            if (active[i]) {
+                auto n = (double) entries_per_level[i];
+                sum_entries += n;
+                sum_entries_log += n * std::log(n);
+            }
+        }
+        if (sum_entries == 0) {
+            break;
+        }
+
+        double neg_log_lambda = ((double) budget_bits * ln2_squared + sum_entries_log) / sum_entries;
+        for (size_t i = 0; i < entries_per_level.size(); ++i) {
+            if (not active[i]) {
+                result[i] = 0;
+                continue;
+            }
+
+            // bits per key = ln(1 / p_i) / ln(2)^2 with p_i = lambda * N_i
+            result[i] = (neg_log_lambda - std::log((double) entries_per_level[i])) / ln2_squared;
+            if (result[i] <= 0) {
+                active[i] = false;
+                result[i] = 0;
+                changed = true;
+            }
+        }
+    }
+
+    return result;
+}
@@ -0,0 +1,44 @@
+#ifndef FILTER_ALLOCATION_H
+#define FILTER_ALLOCATION_H
+
+#include <cstdint>
+#include <vector>
+
+/**
+ * Decide how many bloom filter bits per key a new SST gets.
+ *
+ * Without a memory budget every SST gets the same bits per key.
+ * With a budget the bits are spread across the levels as described in
+ * Monkey (Dayan et al., SIGMOD 2017): the expected number of wasted SST
+ * probes of a lookup is the sum of the false positive rates of all levels,
+ * which is minimal if every level gets a false positive rate proportional
+ * to its number of entries. Small, shallow levels thus get low rates and
+ * the deepest level the highest one, or no filter at all.
+ * The budget is split over the entries the tree will hold once the new SST
+ * is installed, so the inputs of a compaction are not counted next to its
+ * outputs. Filters are only sized when an SST is written: the budget is the
+ * target of new filters, existing ones converge to it as compactions
+ * rewrite their SSTs.
+ */
+class filter_allocation {
+
+    public:
+        explicit filter_allocation(double bits_per_key);
+
+        filter_allocation(std::vector<uint64_t> entries_per_level, uint64_t budget_bits, bool skip_last_level);
+
+        double bits_per_key(uint32_t level_order, uint64_t num_entries) const;
+
+        static std::vector<double>
+            optimal_bits_per_key(const std::vector<uint64_t>& entries_per_level, uint64_t budget_bits, bool skip_last_level);
+
+    private:
+        double fixed_bits_per_key{0};
+        bool use_budget{false};
+
+        std::vector<uint64_t> entries_per_level;
+        uint64_t budget_bits{0};
+        bool skip_last_level{false};
+};
+
+#endif // FILTER_ALLOCATION_H
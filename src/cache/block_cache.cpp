@@ -0,0 +1,307 @@
+#include "block_cache.hpp"
+#include <algorithm>
+
+namespace {
+    // Bookkeeping cost of a cached block on top of its contents.
+    const uint64_t ENTRY_OVERHEAD{64};
+
+    std::atomic<uint64_t> next_sst_id{1};
+
+    uint64_t mix(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xff51afd7ed558ccdULL;
+        key ^= key >> 33;
+        key *= 0xc4ceb9fe1a85ec53ULL;
+        key ^= key >> 33;
+        return key;
+    }
+} // namespace
+
+/**
+ * Common interface of a cache shard. Every call holds the shard lock.
+ */
+class block_cache::shard {
+
+    public:
+        explicit shard(uint64_t capacity): capacity(capacity) {}
+
+        virtual ~shard() = default;
+
+        block lookup(const cache_key& key) {
+            std::lock_guard<std::mutex> guard(mutex);
+            block result = lookup_locked(key);
+            if (result != nullptr) {
+                ++counters.hits;
+            } else {
+                ++counters.misses;
+            }
+            return result;
+        }
+
+        void insert(const cache_key& key, const block& value, priority pri) {
+            uint64_t charge = value->size() + ENTRY_OVERHEAD;
+            if (charge > capacity) {
+                // Never cache a block which would flush the whole shard.
+                return;
+            }
+
+            std::lock_guard<std::mutex> guard(mutex);
+            ++counters.inserts;
+            insert_locked(key, value, charge, pri);
+        }
+
+        void add_stats(stats& total) {
+            std::lock_guard<std::mutex> guard(mutex);
+            total.hits += counters.hits;
+            total.misses += counters.misses;
+            total.inserts += counters.inserts;
+            total.evictions += counters.evictions;
+            total.usage += usage;
+            total.capacity += capacity;
+        }
+
+    protected:
+        std::mutex mutex;
+        uint64_t capacity;
+        uint64_t usage{0};
+        stats counters;
+
+        virtual block lookup_locked(const cache_key& key) = 0;
+
+        virtual void insert_locked(const cache_key& key, const block& value, uint64_t charge, priority pri) = 0;
+};
+
+/**
+ * LRU shard with two lists. New and hit HIGH priority blocks go to the head
+ * of the high list, LOW priority blocks to the head of the low list. If the
+ * high pool outgrows its share, its tail is demoted to the low list.
+ * Eviction always starts at the tail of the low list.
+ */
+class block_cache::lru_shard : public block_cache::shard {
+
+    public:
+        lru_shard(uint64_t capacity, double high_pri_ratio)
+            : shard(capacity), high_capacity((uint64_t) ((double) capacity * high_pri_ratio)) {}
+
+    private:
+        struct entry {
+            cache_key key;
+            block value;
+            uint64_t charge;
+            bool high;
+        };
+
+        using entry_list = std::list<entry>;
+
+        uint64_t high_capacity;
+        uint64_t high_usage{0};
+        entry_list high_list;
+        entry_list low_list;
+        std::unordered_map<cache_key, entry_list::iterator, cache_key_hash> table;
+
+        block lookup_locked(const cache_key& key) override {
+            auto it = table.find(key);
+            if (it == table.end()) {
+                return nullptr;
+            }
+
+            entry_list& list = it->second->high ? high_list : low_list;
+            list.splice(list.begin(), list, it->second);
+            return it->second->value;
+        }
+
+        void insert_locked(const cache_key& key, const block& value, uint64_t charge, priority pri) override {
+            auto existing = table.find(key);
+            if (existing != table.end()) {
+                remove(existing->second);
+                table.erase(existing);
+            }
+
+            while (usage + charge > capacity and not (low_list.empty() and high_list.empty())) {
+                entry_list& victims = low_list.empty() ? high_list : low_list;
+                auto victim = std::prev(victims.end());
+                table.erase(victim->key);
+                remove(victim);
+                ++counters.evictions;
+            }
+
+            bool high = pri == HIGH;
+            entry_list& list = high ? high_list : low_list;
+            list.push_front({key, value, charge, high});
+            table[key] = list.begin();
+
+            usage += charge;
+            if (high) {
+                high_usage += charge;
+                balance_high_pool();
+            }
+        }
+
+        void remove(entry_list::iterator it) {
+            usage -= it->charge;
+            if (it->high) {
+                high_usage -= it->charge;
+                high_list.erase(it);
+            } else {
+                low_list.erase(it);
+            }
+        }
+
+        void balance_high_pool() {
+            while (high_usage > high_capacity and not high_list.empty()) {
+                auto demoted = std::prev(high_list.end());
+                demoted->high = false;
+                high_usage -= demoted->charge;
+                low_list.splice(low_list.begin(), high_list, demoted);
+            }
+        }
+};
+
+/**
+ * CLOCK shard. Every slot carries a small usage counter which the clock hand
+ * decrements while sweeping and a hit increments. Only slots with a counter
+ * of zero are evicted. HIGH priority blocks start with the maximum counter
+ * so they survive several sweeps without being hit.
+ */
+class block_cache::clock_shard : public block_cache::shard {
+
+    public:
+        explicit clock_shard(uint64_t capacity): shard(capacity) {}
+
+    private:
+        static const uint8_t MAX_COUNTER{3};
+
+        struct slot {
+            cache_key key{0, 0};
+            block value;
+            uint64_t charge{0};
+            uint8_t counter{0};
+            bool used{false};
+        };
+
+        std::vector<slot> slots;
+        std::vector<size_t> free_slots;
+        size_t hand{0};
+        std::unordered_map<cache_key, size_t, cache_key_hash> table;
+
+        block lookup_locked(const cache_key& key) override {
+            auto it = table.find(key);
+            if (it == table.end()) {
+                return nullptr;
+            }
+
+            slot& s = slots[it->second];
+            s.counter = std::min<uint8_t>(s.counter + 1, MAX_COUNTER);
+            return s.value;
+        }
+
+        void insert_locked(const cache_key& key, const block& value, uint64_t charge, priority pri) override {
+            auto existing = table.find(key);
+            if (existing != table.end()) {
+                release(existing->second);
+                table.erase(existing);
+            }
+
+            while (usage + charge > capacity and table.size() > 0) {
+                evict_one();
+            }
+
+            size_t slot_i;
+            if (free_slots.empty()) {
+                slot_i = slots.size();
+                slots.emplace_back();
+            } else {
+                slot_i = free_slots.back();
+                free_slots.pop_back();
+            }
+
+            slots[slot_i] = {key, value, charge, (uint8_t) (pri == HIGH ? MAX_COUNTER : 1), true};
+            table[key] = slot_i;
+            usage += charge;
+        }
+
+        void evict_one() {
+            while (true) {
+                hand = hand >= slots.size() ? 0 : hand;
+                slot& s = slots[hand];
+
+                if (s.used and s.counter == 0) {
+                    table.erase(s.key);
+                    release(hand++);
+                    ++counters.evictions;
+                    return;
+                }
+
+                if (s.used) {
+                    --s.counter;
+                }
+                ++hand;
+            }
+        }
+
+        void release(size_t slot_i) {
+            slot& s = slots[slot_i];
+            usage -= s.charge;
+            s = slot{};
+            free_slots.push_back(slot_i);
+        }
+};
+
+size_t block_cache::cache_key_hash::operator()(const cache_key& key) const {
+    return (size_t) mix(key.sst_id * 0x9e3779b97f4a7c15ULL ^ key.offset);
+}
+
+block_cache::block_cache(uint64_t capacity, eviction_policy policy, uint32_t num_shard_bits, double high_pri_ratio)
+        : num_shard_bits(num_shard_bits) {
+    uint64_t num_shards = 1ULL << num_shard_bits;
+    uint64_t shard_capacity = (capacity + num_shards - 1) / num_shards;
+
+    for (uint64_t i = 0; i < num_shards; ++i) {
+        if (policy == CLOCK) {
+            shards.push_back(std::make_unique<clock_shard>(shard_capacity));
+        } else {
+            shards.push_back(std::make_unique<lru_shard>(shard_capacity, high_pri_ratio));
+        }
+    }
+}
+
+block_cache::~block_cache() = default;
+
+block_cache::block block_cache::lookup(uint64_t sst_id, uint64_t offset) {
+    cache_key key{sst_id, offset};
+    return get_shard(key).lookup(key);
+}
+
+/**
+ * Insert a block and return the cached handle to it.
+ * Blocks larger than a shard are returned without being cached.
+ */
+block_cache::block block_cache::insert(uint64_t sst_id, uint64_t offset, std::string contents, priority pri) {
+    cache_key key{sst_id, offset};
+    block value = std::make_shared<const std::string>(std::move(contents));
+    get_shard(key).insert(key, value, pri);
+    return value;
+}
+
+block_cache::stats block_cache::get_stats() const {
+    stats total;
+    for (const auto& s : shards) {
+        s->add_stats(total);
+    }
+    return total;
+}
+
+/**
+ * Every opened SST gets a process wide unique id, so ids are never reused
+ * by a later SST even if its file name is.
+ */
+uint64_t block_cache::new_sst_id() {
+    return next_sst_id.fetch_add(1, std::memory_order_relaxed);
+}
+
+block_cache::shard& block_cache::get_shard(const cache_key& key) {
+    if (num_shard_bits == 0) {
+        return *shards[0];
+    }
+    return *shards[cache_key_hash()(key) >> (64 - num_shard_bits)];
+}
@@ -0,0 +1,78 @@
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * Fixed capacity cache for SST blocks keyed by (SST id, block offset).
+ * The cache is split into 2^num_shard_bits shards with their own lock and
+ * their own share of the capacity, so concurrent readers rarely contend.
+ * Each shard evicts either by LRU or by CLOCK. With LRU, blocks inserted
+ * with HIGH priority (index and filter blocks) are kept in a separate pool
+ * which is only evicted once all low priority blocks are gone. CLOCK has no
+ * reserved pool, a HIGH block only starts with a higher counter and so
+ * survives more sweeps of the hand.
+ *
+ * Cached blocks are reference counted, an evicted block stays valid for
+ * readers which still hold it.
+ */
+class block_cache {
+
+    public:
+        enum eviction_policy {LRU, CLOCK};
+
+        enum priority {LOW, HIGH};
+
+        using block = std::shared_ptr<const std::string>;
+
+        struct stats {
+            uint64_t hits{0};
+            uint64_t misses{0};
+            uint64_t inserts{0};
+            uint64_t evictions{0};
+            uint64_t usage{0};
+            uint64_t capacity{0};
+        };
+
+        block_cache(uint64_t capacity, eviction_policy policy, uint32_t num_shard_bits, double high_pri_ratio);
+
+        ~block_cache();
+
+        block lookup(uint64_t sst_id, uint64_t offset);
+
+        block insert(uint64_t sst_id, uint64_t offset, std::string contents, priority pri);
+
+        stats get_stats() const;
+
+        static uint64_t new_sst_id();
+
+    private:
+        struct cache_key {
+            uint64_t sst_id;
+            uint64_t offset;
+
+            bool operator==(const cache_key& other) const = default;
+        };
+
+        struct cache_key_hash {
+            size_t operator()(const cache_key& key) const;
+        };
+
+        class shard;
+        class lru_shard;
+        class clock_shard;
+
+        std::vector<std::unique_ptr<shard>> shards;
+        uint32_t num_shard_bits;
+
+        shard& get_shard(const cache_key& key);
+};
+
+#endif // BLOCK_CACHE_H
@@ -0,0 +1,186 @@
+#include "compaction_policy.hpp"
+#include <algorithm>
+#include <cmath>
+
+std::unique_ptr<compaction_policy> compaction_policy::create(style compaction_style, uint32_t size_ratio, uint64_t buffer_size) {
+    size_ratio = std::max<uint32_t>(size_ratio, 2);
+
+    switch (compaction_style) {
+        case LEVELED:
+            return std::make_unique<leveled_policy>(size_ratio, buffer_size);
+        case LAZY_LEVELED:
+            return std::make_unique<lazy_leveled_policy>(size_ratio, buffer_size);
+        case TIERED:
+        default:
+            return std::make_unique<tiered_policy>(size_ratio);
+    }
+}
+
+/**
+ * Return the job of the level with the highest score of at least 1 whose
+ * levels are not busy with another job. Ties go to the upper level, whose
+ * SSTs are read first.
+ */
+std::optional<compaction_job> compaction_policy::pick(const segment_list& segments, const std::set<uint32_t>& busy_levels) const {
+    std::vector<std::pair<double, segment_list::const_iterator>> candidates;
+    for (auto it = segments.begin(); it != segments.end(); ++it) {
+        double level_score = score(segments, it);
+        if (level_score >= 1) {
+            candidates.emplace_back(level_score, it);
+        }
+    }
+
+    std::stable_sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+
+    for (const auto& candidate : candidates) {
+        compaction_job job = plan(segments, candidate.second);
+        if (not busy_levels.contains(job.level_order) and not busy_levels.contains(job.target_level)) {
+            job.bottommost = is_bottommost(segments, job);
+            return job;
+        }
+    }
+    return {};
+}
+
+uint64_t compaction_policy::level_bytes(const std::vector<std::shared_ptr<level>>& level_segments) {
+    uint64_t bytes{0};
+    for (const auto& sst : level_segments) {
+        bytes += sst->get_file_size();
+    }
+    return bytes;
+}
+
+size_t compaction_policy::count_runs(const std::vector<std::shared_ptr<level>>& level_segments) {
+    size_t runs{0};
+    for (size_t i = 0; i < level_segments.size(); ++i) {
+        if (i == 0 or level_segments[i]->get_run_id() != level_segments[i - 1]->get_run_id()) {
+            ++runs;
+        }
+    }
+    return runs;
+}
+
+/**
+ * Return all SSTs of the @param num_runs oldest runs of a level.
+ */
+std::vector<std::shared_ptr<level>> compaction_policy::oldest_runs(const std::vector<std::shared_ptr<level>>& level_segments, size_t num_runs) {
+    std::vector<std::shared_ptr<level>> result;
+    for (size_t i = 0; i < level_segments.size(); ++i) {
+        if (i > 0 and level_segments[i]->get_run_id() != level_segments[i - 1]->get_run_id() and --num_runs == 0) {
+            break;
+        }
+        result.push_back(level_segments[i]);
+    }
+    return result;
+}
+
+/**
+ * Level i holds up to T^(i + 1) memtables worth of data.
+ */
+double compaction_policy::level_capacity(uint32_t level_order, uint32_t size_ratio, uint64_t buffer_size) {
+    return (double) buffer_size * std::pow((double) size_ratio, level_order + 1);
+}
+
+/**
+ * The output of @param job is the oldest data of the tree if no level below
+ * the target level holds SSTs and the job takes the oldest run of the
+ * target level, or the target level is empty. The runs of the target level
+ * the job leaves behind are newer then.
+ * Both stay true while the job runs: the target level is busy, so no other
+ * job writes to it or moves its runs further down.
+ */
+bool compaction_policy::is_bottommost(const segment_list& segments, const compaction_job& job) {
+    for (const auto& curr_level : segments) {
+        if (curr_level.first < job.target_level or curr_level.second.empty()) {
+            continue;
+        }
+        if (curr_level.first > job.target_level or job.inputs.empty() or curr_level.second.front() != job.inputs.front()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+leveled_policy::leveled_policy(uint32_t size_ratio, uint64_t buffer_size)
+        : size_ratio(size_ratio), buffer_size(buffer_size) {}
+
+/**
+ * Level 0 is scored by its number of runs, every other level by its size.
+ * A lower level with more than one run, e.g. left over from another
+ * policy, is always compacted.
+ */
+double leveled_policy::score(const segment_list&, segment_list::const_iterator curr_level) const {
+    const auto& level_segments = curr_level->second;
+    if (curr_level->first == 0) {
+        return (double) count_runs(level_segments) / LEVEL0_TRIGGER;
+    }
+
+    double level_score = (double) level_bytes(level_segments) / level_capacity(curr_level->first, size_ratio, buffer_size);
+    if (count_runs(level_segments) > 1) {
+        level_score = std::max(level_score, 1.0);
+    }
+    return level_score;
+}
+
+/**
+ * Merge all runs of the level with the run of the next level.
+ */
+compaction_job leveled_policy::plan(const segment_list& segments, segment_list::const_iterator curr_level) const {
+    compaction_job job{curr_level->first, curr_level->first + 1, {}};
+
+    auto next_level = std::next(curr_level);
+    if (next_level != segments.end() and next_level->first == job.target_level) {
+        job.inputs = next_level->second;
+    }
+    job.inputs.insert(job.inputs.end(), curr_level->second.begin(), curr_level->second.end());
+    return job;
+}
+
+tiered_policy::tiered_policy(uint32_t size_ratio): size_ratio(size_ratio) {}
+
+double tiered_policy::score(const segment_list&, segment_list::const_iterator curr_level) const {
+    return (double) count_runs(curr_level->second) / size_ratio;
+}
+
+/**
+ * Merge the T oldest runs of the level into a new run on the next level.
+ */
+compaction_job tiered_policy::plan(const segment_list&, segment_list::const_iterator curr_level) const {
+    return {curr_level->first, curr_level->first + 1, oldest_runs(curr_level->second, size_ratio)};
+}
+
+lazy_leveled_policy::lazy_leveled_policy(uint32_t size_ratio, uint64_t buffer_size)
+        : tiered_policy(size_ratio), buffer_size(buffer_size) {}
+
+/**
+ * The last level is compacted as soon as it has a second run or outgrows
+ * its capacity, all other levels are tiered.
+ */
+double lazy_leveled_policy::score(const segment_list& segments, segment_list::const_iterator curr_level) const {
+    if (std::next(curr_level) != segments.end()) {
+        return tiered_policy::score(segments, curr_level);
+    }
+
+    const auto& level_segments = curr_level->second;
+    size_t runs = count_runs(level_segments);
+    if (runs > 1) {
+        return (double) runs;
+    }
+    return (double) level_bytes(level_segments) / level_capacity(curr_level->first, size_ratio, buffer_size);
+}
+
+/**
+ * Merge all runs of the last level in place, or move its single run one
+ * level down once it is full.
+ */
+compaction_job lazy_leveled_policy::plan(const segment_list& segments, segment_list::const_iterator curr_level) const {
+    if (std::next(curr_level) != segments.end()) {
+        return tiered_policy::plan(segments, curr_level);
+    }
+
+    const auto& level_segments = curr_level->second;
+    uint32_t target_level = count_runs(level_segments) > 1 ? curr_level->first : curr_level->first + 1;
+    return {curr_level->first, target_level, level_segments};
+}
@@ -0,0 +1,140 @@
+#ifndef COMPACTION_POLICY_H
+#define COMPACTION_POLICY_H
+
+#include "../lsm_tree/level/level.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <optional>
+#include <set>
+#include <vector>
+
+/**
+ * Merge of the inputs into a single sorted run on the target level.
+ * Inputs are ordered oldest first: SSTs taken from the target level come
+ * first and are always a prefix of it, followed by a prefix of the SSTs on
+ * level_order.
+ * A bottommost job writes the oldest data of the tree, nothing older is
+ * left that its deletes could hide.
+ */
+struct compaction_job {
+    uint32_t level_order;
+    uint32_t target_level;
+    std::vector<std::shared_ptr<level>> inputs;
+    bool bottommost{false};
+};
+
+/**
+ * Totals over all compactions and value log GC rewrites of a tree.
+ * Reclaimed bytes count the keys and values of the dropped records, for a
+ * separated value the value in the value log, and the bounds of the dropped
+ * range tombstones.
+ */
+struct compaction_stats {
+    uint64_t compactions{0};
+    uint64_t bottommost_compactions{0};
+    uint64_t dropped_tombstones{0};
+    uint64_t dropped_versions{0};
+    uint64_t reclaimed_bytes{0};
+};
+
+/**
+ * Decides which SSTs to merge next. Every level gets a score against its
+ * target size and the most urgent level whose job touches no busy level
+ * is picked. Adjacent SSTs with the same run id form one sorted run, and
+ * jobs always take whole runs.
+ */
+class compaction_policy {
+
+    public:
+        enum style {
+            LEVELED,
+            TIERED,
+            LAZY_LEVELED
+        };
+
+        virtual ~compaction_policy() = default;
+
+        static std::unique_ptr<compaction_policy> create(style compaction_style, uint32_t size_ratio, uint64_t buffer_size);
+
+        std::optional<compaction_job> pick(const segment_list& segments, const std::set<uint32_t>& busy_levels) const;
+
+    protected:
+        // Compaction is needed once a level has a score of at least 1.
+        virtual double score(const segment_list& segments, segment_list::const_iterator curr_level) const = 0;
+
+        virtual compaction_job plan(const segment_list& segments, segment_list::const_iterator curr_level) const = 0;
+
+        static uint64_t level_bytes(const std::vector<std::shared_ptr<level>>& level_segments);
+
+        static size_t count_runs(const std::vector<std::shared_ptr<level>>& level_segments);
+
+        static std::vector<std::shared_ptr<level>> oldest_runs(const std::vector<std::shared_ptr<level>>& level_segments, size_t num_runs);
+
+        static double level_capacity(uint32_t level_order, uint32_t size_ratio, uint64_t buffer_size);
+
+        static bool is_bottommost(const segment_list& segments, const compaction_job& job);
+};
+
+/**
+ * Every level holds at most one run, except level 0 which collects
+ * flushes until it has 2 SSTs. Level i >= 1 may hold buffer_size * T^(i + 1)
+ * bytes before it is merged into the run of the next level.
+ * Lowest read and space amplification, highest write amplification.
+ */
+class leveled_policy : public compaction_policy {
+
+    public:
+        leveled_policy(uint32_t size_ratio, uint64_t buffer_size);
+
+    protected:
+        double score(const segment_list& segments, segment_list::const_iterator curr_level) const override;
+
+        compaction_job plan(const segment_list& segments, segment_list::const_iterator curr_level) const override;
+
+    private:
+        static const size_t LEVEL0_TRIGGER{2};
+
+        uint32_t size_ratio;
+        uint64_t buffer_size;
+};
+
+/**
+ * Every level collects T runs, which are merged into one new run on the
+ * next level. Lowest write amplification, highest read amplification.
+ */
+class tiered_policy : public compaction_policy {
+
+    public:
+        explicit tiered_policy(uint32_t size_ratio);
+
+    protected:
+        double score(const segment_list& segments, segment_list::const_iterator curr_level) const override;
+
+        compaction_job plan(const segment_list& segments, segment_list::const_iterator curr_level) const override;
+
+        uint32_t size_ratio;
+};
+
+/**
+ * Tiered upper levels and a leveled last level: new runs on the last level
+ * are merged into its single run right away. The last level moves one
+ * level down once it outgrows buffer_size * T^(i + 1) bytes.
+ * Write amplification close to tiering, with a single run on the level
+ * that holds most of the data.
+ */
+class lazy_leveled_policy : public tiered_policy {
+
+    public:
+        lazy_leveled_policy(uint32_t size_ratio, uint64_t buffer_size);
+
+    protected:
+        double score(const segment_list& segments, segment_list::const_iterator curr_level) const override;
+
+        compaction_job plan(const segment_list& segments, segment_list::const_iterator curr_level) const override;
+
+    private:
+        uint64_t buffer_size;
+};
+
+#endif // COMPACTION_POLICY_H
@@ -0,0 +1,83 @@
+#include "fence_pointers.hpp"
+
+fence_pointers::fence_pointers(const std::vector<index_entry>& entries) {
+    size_t arena_size{0};
+    for (const index_entry& entry : entries) {
+        arena_size += entry.first_key.size();
+    }
+
+    key_arena.reserve(arena_size);
+    key_offsets.reserve(entries.size() + 1);
+    key_prefixes.reserve(entries.size());
+    handles.reserve(entries.size());
+
+    for (const index_entry& entry : entries) {
+        key_offsets.push_back((uint32_t) key_arena.size());
+        key_prefixes.push_back(prefix_of(entry.first_key));
+        key_arena.append(entry.first_key);
+        handles.push_back(entry.handle);
+    }
+    key_offsets.push_back((uint32_t) key_arena.size());
+}
+
+/**
+ * Return the position of the last fence pointer whose key is <= target, or
+ * nothing if the target is smaller than the first key of the SST.
+ * The loop halves the search range without data dependent branches, the
+ * comparison result only selects the next base.
+ */
+std::optional<size_t> fence_pointers::floor(std::string_view target) const {
+    if (handles.empty()) {
+        return {};
+    }
+
+    uint64_t target_prefix = prefix_of(target);
+    size_t base{0};
+    size_t n = handles.size();
+
+    while (n > 1) {
+        size_t half = n / 2;
+        base = less_equal(base + half, target_prefix, target) ? base + half : base;
+        n -= half;
+    }
+
+    if (not less_equal(base, target_prefix, target)) {
+        return {};
+    }
+    return base;
+}
+
+size_t fence_pointers::size() const {
+    return handles.size();
+}
+
+std::string_view fence_pointers::key_at(size_t i) const {
+    return std::string_view(key_arena).substr(key_offsets[i], key_offsets[i + 1] - key_offsets[i]);
+}
+
+const block_handle& fence_pointers::handle_at(size_t i) const {
+    return handles[i];
+}
+
+uint64_t fence_pointers::prefix_of(std::string_view key) {
+    uint64_t prefix{0};
+    for (size_t i = 0; i < 8; ++i) {
+        prefix <<= 8;
+        if (i < key.size()) {
+            prefix |= (unsigned char) key[i];
+        }
+    }
+    return prefix;
+}
+
+/**
+ * Check if the key at position i is <= target. Only if both 8 byte prefixes
+ * are equal the full keys have to be compared.
+ */
+bool fence_pointers::less_equal(size_t i, uint64_t target_prefix, std::string_view target) const {
+    uint64_t prefix = key_prefixes[i];
+    if (prefix != target_prefix) {
+        return prefix < target_prefix;
+    }
+    return key_at(i) <= target;
+}
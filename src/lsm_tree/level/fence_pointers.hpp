@@ -0,0 +1,45 @@
+#ifndef FENCE_POINTERS_H
+#define FENCE_POINTERS_H
+
+#include "../../sst/format.hpp"
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Immutable Sparse Index of an SST with one fence pointer per data block.
+ * The first keys of all blocks are stored back to back in one flat arena and
+ * the block handles in one contiguous vector, so a lookup touches a handful
+ * of cache lines instead of chasing tree nodes on the heap.
+ */
+class fence_pointers {
+
+    public:
+        fence_pointers() = default;
+
+        explicit fence_pointers(const std::vector<index_entry>& entries);
+
+        std::optional<size_t> floor(std::string_view target) const;
+
+        size_t size() const;
+
+        std::string_view key_at(size_t i) const;
+
+        const block_handle& handle_at(size_t i) const;
+
+    private:
+        std::string key_arena;
+        std::vector<uint32_t> key_offsets;
+        // Big-endian 8 byte prefix of every key to resolve most comparisons
+        // without touching the arena.
+        std::vector<uint64_t> key_prefixes;
+        std::vector<block_handle> handles;
+
+        static uint64_t prefix_of(std::string_view key);
+
+        bool less_equal(size_t i, uint64_t target_prefix, std::string_view target) const;
+};
+
+#endif // FENCE_POINTERS_H
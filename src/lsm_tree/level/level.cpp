@@ -1,136 +1,232 @@
 #include "level.hpp"
+#include "sst_cursor.hpp"
 #include <algorithm>
 #include <string>
-#include <iostream>
-#include <fstream>
-#include <unordered_set>
+#include <sstream>
+#include <iomanip>
+#include <set>
+
+namespace {
+
+    /**
+     * A version of @param key in snapshot stripe @param stripe is dropped
+     * if a range tombstone of the same stripe deletes it. No snapshot reads
+     * the version then, since every snapshot that sees it also sees the
+     * tombstone.
+     */
+    bool is_covered(const range_tombstone_list& tombstones, std::string_view key, uint64_t sequence, size_t stripe,
+                    const std::vector<uint64_t>& snapshots) {
+        uint64_t stripe_end = stripe < snapshots.size() ? snapshots[stripe] : UINT64_MAX;
+        return tombstones.max_covering(key, stripe_end) > sequence;
+    }
+
+} // namespace
 
 /**
- * Init a new SST based on the flushed Memtable.
+ * Init a new SST based on the flushed Memtable, keeping the versions the
+ * live @param snapshots read. A partly written file is deleted if writing
+ * fails.
  */
-level::level(const std::string &path, long bloom_size, red_black_tree &memtable)
-        : bloom(bloom_size), index() {
+level::level(const std::string &path, const filter_allocation& filters, const skiplist_memtable &memtable,
+             const std::vector<uint64_t>& snapshots, block_cache* cache, value_log* vlog)
+        : cache(cache) {
     this->path = path;
-    create_sst_from_memtable(memtable);
+    run_id = extract_id_level_from_path(path).first;
+    try {
+        create_sst_from_memtable(memtable, filters, snapshots, vlog);
+    } catch (...) {
+        delete_segment_file();
+        throw;
+    }
 }
 
 /**
- * Merge two existing SSTs into a new one.
+ * Merge the keys of existing SSTs, ordered oldest first, that fall into
+ * @param range into a new SST of the sorted run @param run_id.
+ * @param bottommost tells if nothing older than the inputs is left.
+ * Like a flush, a failed merge deletes its partly written file.
  */
-level::level(const std::string &path, level* sst_a, level* sst_b, long bloom_size)
-        : bloom(bloom_size), index() {
+level::level(const std::string &path, const std::vector<std::shared_ptr<level>>& inputs, const key_range& range, uint64_t run_id,
+             bool bottommost, const filter_allocation& filters, const std::vector<uint64_t>& snapshots, block_cache* cache,
+             value_log* vlog)
+        : cache(cache), run_id(run_id) {
     this->path = path;
-    merge_sst_values(sst_a, sst_b);
+    try {
+        merge_sst_values(inputs, range, bottommost, filters, snapshots, vlog);
+    } catch (...) {
+        delete_segment_file();
+        throw;
+    }
 }
 
 /**
  * Create a new SST based on its existing segment file.
  * Only needed for repopulating the segments into Memory after restarting the db.
+ * The value log files the SST points into are taken from @param vlog.
  */
-level::level(const std::string& path, long bloom_size)
-        : bloom(bloom_size), index() {
+level::level(const std::string& path, double bits_per_key, block_cache* cache, const value_log& vlog)
+        : cache(cache) {
     this->path = path;
-    repopulate_bloom_and_index();
+    repopulate_bloom_and_index(bits_per_key, vlog);
 }
 
 level::~level() {
-    index.delete_tree();
-    delete_segment_file();
+    value_files.release();
+    reader.reset();
+    if (not file_kept.load(std::memory_order_relaxed)) {
+        delete_segment_file();
+    }
+}
+
+/**
+ * Return an unpositioned cursor over the keys visible at @param sequence.
+ * The level has to outlive the cursor.
+ */
+std::unique_ptr<cursor> level::new_cursor(uint64_t sequence) const {
+    return std::make_unique<sst_cursor>(*reader, index, value_files, sequence);
 }
 
 std::string level::get_name() const {
     return path;
 }
 
+uint16_t level::get_level_order() const {
+    return extract_id_level_from_path(path).second;
+}
+
+uint64_t level::get_num_entries() const {
+    return num_entries;
+}
+
+uint64_t level::get_file_size() const {
+    return reader->get_file().size();
+}
+
+/**
+ * SSTs written by the same compaction share the run id and together form
+ * one sorted run with disjoint key ranges.
+ */
+uint64_t level::get_run_id() const {
+    return run_id;
+}
+
+uint64_t level::get_max_sequence() const {
+    return max_sequence;
+}
+
+const range_tombstone_list& level::get_range_tombstones() const {
+    return range_tombstones;
+}
+
+/**
+ * Only set for SSTs written by a merge, until the process restarts.
+ */
+const level::drop_stats& level::get_drop_stats() const {
+    return dropped;
+}
+
 /*
  * Create a new filename based on the segment ID and the level of the segment, e.g.
  * 00001_00010 (id = 1, level = 10).
  */
-std::string level::create_filename_based_on_level(uint16_t id, uint16_t level_order) {
+std::string level::create_filename_based_on_level(uint64_t id, uint16_t level_order) {
     std::ostringstream ss;
-    // Pad id and level_order to 00000 since uint16_t is max 65535.
+    // Pad id and level_order to 00000. Ids never wrap and grow beyond five
+    // digits, level_order is max 65535.
     ss << std::setw(5) << std::setfill('0') << id << "_";
     ss << std::setw(5) << std::setfill('0') << level_order;
     return ss.str();
 }
 
-std::pair<uint16_t, uint16_t> level::extract_id_level_from_path(const std::string& path) {
+std::pair<uint64_t, uint16_t> level::extract_id_level_from_path(const std::string& path) {
     std::string filename = path.substr(path.find_last_of("/\\") + 1);
+    size_t separator = filename.find('_');
 
-    uint16_t id = (uint16_t) std::stoul(filename.substr(0, 5));
-    uint16_t level_order = std::stoi(filename.substr(6, 5));
+    uint64_t id = std::stoull(filename.substr(0, separator));
+    auto level_order = (uint16_t) std::stoul(filename.substr(separator + 1, 5));
 
     return {id, level_order};
 }
 
 /**
- * Get all nodes from memtable in-order and write them to the disk.
- * Populate the bloom filter and insert every SPARSITY_INDEX'th node inside
- * the sparse index.
+ * Iterate over the memtable in-order and write it to the disk as a binary SST.
+ * Of the versions of a key, the newest one is written, and of the older
+ * ones only those a live snapshot in @param snapshots reads. Versions that
+ * a range tombstone of the memtable deletes for every snapshot are
+ * dropped, the tombstones themselves go into the range tombstone block.
+ * Large values are moved to the value log, see add_record().
+ * Build a bloom filter over all keys with the bits per key the allocation
+ * assigns to this level, persist it in the filter block and build the fence
+ * pointers over the data blocks.
  */
-void level::create_sst_from_memtable(red_black_tree &memtable) {
-    std::ofstream sst;
-    sst.open(path);
-
-    uint64_t sparsity_i{0};
-    uint64_t pos{0};
-
-    std::vector<rb_entry> rb_nodes = memtable.get_and_delete_all_nodes();
-    for (rb_entry& node : rb_nodes) {
-        kv_pair pair = {node.key, std::any_cast<std::string>(node.val.value())};
-        bloom.set(pair.key);
-
-        std::string log_entry = pair.to_log_entry();
-        sst << log_entry;
-
-        if (sparsity_i++ == SPARSITY_FACTOR) {
-            index.insert(rb_entry{pair.key, pos});
-            sparsity_i = 0;
-        }
+void level::create_sst_from_memtable(const skiplist_memtable &memtable, const filter_allocation& filters,
+                                     const std::vector<uint64_t>& snapshots, value_log* vlog) {
+    sst_writer writer(path);
+    std::unique_ptr<value_log_writer> values;
+
+    std::shared_ptr<const range_tombstone_list> memtable_tombstones = memtable.get_range_tombstones();
+    if (memtable_tombstones != nullptr) {
+        range_tombstones = *memtable_tombstones;
+    }
 
-        pos += log_entry.size();
+    std::vector<uint64_t> key_hashes;
+    key_hashes.reserve(memtable.get_num_entries());
+
+    skiplist::iterator it = memtable.new_iterator();
+    for (it.seek_to_first(); it.valid(); it.next()) {
+        bool key_added{false};
+        size_t last_stripe{SIZE_MAX};
+        do {
+            size_t stripe = snapshot_list::stripe(it.sequence(), snapshots);
+            if (stripe != last_stripe and not is_covered(range_tombstones, it.key(), it.sequence(), stripe, snapshots)) {
+                if (not key_added) {
+                    key_hashes.push_back(bloom_filter::hash(it.key()));
+                    key_added = true;
+                }
+                add_record(writer, vlog, values, it.key(), it.sequence(), it.type(), it.value());
+            }
+            last_stripe = stripe;
+        } while (last_stripe > 0 and it.next_version());
     }
-    sst << std::flush;
+
+    finish_sst(writer, values, key_hashes, filters);
 }
 
 /**
  * Search on the SST.
  * First check if the key exists in the bloom filter, if not we are certain that
  * the key does not exists.
- * Then, use the Sparse Index to get a close lower neighbour of the key, every
- * 1000th (SPARSITY_FACTOR) key should exists in the Sparse Index.
- * Iterate from the lower neighbour upwards until we hit a key > target and we
- * can stop.
+ * Then, use the fence pointers to find the data block whose first key is the
+ * closest lower neighbour of the key.
+ * Decode the block in place from the block cache or the mapped file until we
+ * hit a key > target and we can stop. Of the versions of the target, which
+ * are ordered newest first, return the first one visible at @param sequence.
+ * A value moved to the value log is read from there.
  */
-std::optional<std::string> level::search(const std::string &target) const {
+std::optional<key_version> level::search(const std::string &target, uint64_t sequence) const {
     if (not bloom.is_set(target)) {
         return {};
     }
 
-    std::optional<rb_entry> opt_floor_node = index.floor(target);
-    long start_pos{0};
-
-    if (opt_floor_node.has_value()) {
-        start_pos = (long) std::any_cast<uint64_t>(opt_floor_node.value().val.value());
+    std::optional<size_t> block_i = index.floor(target);
+    if (not block_i.has_value()) {
+        // Target is smaller than the first key of the SST.
+        return {};
     }
 
-    std::ifstream sst(path, std::ios_base::in);
-    if (sst.is_open()) {
-        sst.seekg(start_pos, std::ios_base::beg);
-        std::string line, key;
+    block_contents block = reader->get_block(index.handle_at(block_i.value()), block_cache::LOW, true);
 
-        while (std::getline(sst, line)) {
-            size_t seperator_pos = line.find(SEPERATOR);
-            key = line.substr(0, seperator_pos);
-
-            if (target < key) {
-                // Since SST is sorted, we can stop when key is greater than target.
-                return {};
-            }
+    for (block_iterator it(block.data); it.valid(); it.next()) {
+        if (target < it.key()) {
+            // Since SST is sorted, we can stop when key is greater than target.
+            return {};
+        }
 
-            if (target == key) {
-                return {line.substr(seperator_pos + 1, line.size())};
+        if (target == it.key() and it.sequence() <= sequence) {
+            if (it.type() == kv_pair::VALUE_POINTER) {
+                return key_version{kv_pair::PUT, it.sequence(), std::string(value_files.read(it.value()))};
             }
+            return key_version{it.type(), it.sequence(), std::string(it.value())};
         }
     }
 
@@ -138,154 +234,466 @@ std::optional<std::string> level::search(const std::string &target) const {
 }
 
 /**
- * Merge two Sorted String Tables and write them sorted to the disk.
- * Remove duplicated or deleted objects.
+ * Search a batch of sorted, distinct @param targets with their bloom
+ * filter @param hashes and return their values in the same order.
+ * All filter probes run first, so their cache misses overlap. The data
+ * blocks of the remaining targets are then fetched as one batch, which
+ * keeps all their reads in flight at once, and swept in order: targets in
+ * the same block share one block read and one forward scan. Like search(),
+ * only versions visible at @param sequence are returned.
  */
-void level::merge_sst_values(level* sst_a, level* sst_b) {
-    // SST_a is always the latest SST and dominates over SST_b.
-    if (extract_id_level_from_path(sst_a->path).first < extract_id_level_from_path(sst_b->path).first) {
-        std::swap(sst_a, sst_b);
-    }
+std::vector<std::optional<key_version>>
+level::multi_search(const std::vector<std::string_view>& targets, const std::vector<uint64_t>& hashes, uint64_t sequence) const {
+    std::vector<std::optional<key_version>> values(targets.size());
 
-    std::ifstream sst_a_file(sst_a->path, std::ios_base::in);
-    std::ifstream sst_b_file(sst_b->path, std::ios_base::in);
-
-    std::ofstream merged_sst;
-    merged_sst.open(path);
+    for (uint64_t hash : hashes) {
+        bloom.prefetch(hash);
+    }
 
-    std::string last_key;
-    uint64_t sparsity_i{0};
-    uint64_t pos{0};
+    // Candidate targets with the position of their block in block_handles.
+    std::vector<std::pair<size_t, size_t>> candidates;
+    std::vector<block_handle> block_handles;
+    std::optional<size_t> last_block_i;
+    for (size_t i = 0; i < targets.size(); ++i) {
+        if (not bloom.may_contain(hashes[i])) {
+            continue;
+        }
+        std::optional<size_t> block_i = index.floor(targets[i]);
+        if (not block_i.has_value()) {
+            // Target is smaller than the first key of the SST.
+            continue;
+        }
+        // Targets are sorted, so equal blocks are adjacent.
+        if (block_i != last_block_i) {
+            last_block_i = block_i;
+            block_handles.push_back(index.handle_at(block_i.value()));
+        }
+        candidates.emplace_back(i, block_handles.size() - 1);
+    }
 
-    std::string line_a, line_b;
-    kv_pair kv_pair_a, kv_pair_b;
-    kv_pair min_kv_pair;
+    std::vector<block_contents> blocks = reader->get_blocks(block_handles, block_cache::LOW);
 
-    bool sst_a_empty = false;
-    bool sst_b_empty = false;
+    std::optional<size_t> curr_block;
+    std::optional<block_iterator> it;
+    for (const auto& [i, block] : candidates) {
+        if (block != curr_block) {
+            curr_block = block;
+            it.emplace(blocks[block].data);
+        }
 
-    while (true) {
+        // The scan continues where the previous target of the block stopped.
+        while (it->valid() and (it->key() < targets[i] or (it->key() == targets[i] and it->sequence() > sequence))) {
+            it->next();
+        }
+        if (it->valid() and it->key() == targets[i]) {
+            if (it->type() == kv_pair::VALUE_POINTER) {
+                values[i] = key_version{kv_pair::PUT, it->sequence(), std::string(value_files.read(it->value()))};
+            } else {
+                values[i] = key_version{it->type(), it->sequence(), std::string(it->value())};
+            }
+        }
+    }
 
-        if (line_a.empty() and not sst_a_empty) {
-            std::getline(sst_a_file, line_a);
-            sst_a_empty = line_a.empty();
+    return values;
+}
 
-            kv_pair_a = kv_pair::split_log_entry(line_a);
+/**
+ * Merge the records of any number of Sorted String Tables, ordered oldest
+ * first, within @param range and write them sorted to the disk.
+ * The inputs are merged with a heap of their iterators ordered by the
+ * current key and then by descending sequence number, so the versions of a
+ * key come out newest first. The newest version is always kept. An older
+ * version is only kept if a snapshot in @param snapshots reads it, i.e. if
+ * it falls into a different snapshot stripe than the next newer version.
+ * The range tombstones of the inputs are clipped to @param range and
+ * carried over, and versions they delete for every snapshot are dropped.
+ * If the merge is @param bottommost, deletes and range tombstones that
+ * every snapshot sees are dropped too: the versions they hide are dropped
+ * above, and nothing older is left below.
+ * Value pointers are copied as they are, unless they point into a value
+ * log file that is due for garbage collection. Their values are then read
+ * and written again, like the large values still stored in the inputs.
+ */
+void level::merge_sst_values(const std::vector<std::shared_ptr<level>>& inputs, const key_range& range, bool bottommost,
+                             const filter_allocation& filters, const std::vector<uint64_t>& snapshots, value_log* vlog) {
+    std::vector<range_tombstone> clipped;
+    for (const auto& input : inputs) {
+        for (range_tombstone tombstone : input->range_tombstones.get_tombstones()) {
+            if (range.lower.has_value() and tombstone.begin < range.lower.value()) {
+                tombstone.begin = range.lower.value();
+            }
+            if (range.upper.has_value() and range.upper.value() < tombstone.end) {
+                tombstone.end = range.upper.value();
+            }
+            clipped.push_back(std::move(tombstone));
         }
+    }
+    // Versions are checked against all tombstones, even those not kept.
+    range_tombstone_list tombstones(std::move(clipped));
+
+    std::vector<range_tombstone> kept;
+    for (const range_tombstone& tombstone : tombstones.get_tombstones()) {
+        if (bottommost and snapshot_list::stripe(tombstone.sequence, snapshots) == 0) {
+            ++dropped.dropped_tombstones;
+            dropped.reclaimed_bytes += tombstone.begin.size() + tombstone.end.size();
+        } else {
+            kept.push_back(tombstone);
+        }
+    }
+    range_tombstones = range_tombstone_list(std::move(kept));
+
+    std::vector<std::unique_ptr<sst_iterator>> iterators;
+    iterators.reserve(inputs.size());
+    for (const auto& input : inputs) {
+        iterators.push_back(std::make_unique<sst_iterator>(*input->reader));
+        if (range.lower.has_value()) {
+            iterators.back()->seek(range.lower.value());
+        }
+    }
 
-        if (line_b.empty() and not sst_b_empty) {
-            std::getline(sst_b_file, line_b);
-            sst_b_empty = line_b.empty();
-
-            kv_pair_b = kv_pair::split_log_entry(line_b);
+    auto in_range = [&](size_t i) {
+        return iterators[i]->valid() and (not range.upper.has_value() or iterators[i]->key() < range.upper.value());
+    };
+    // std::*_heap keeps the largest element on top, so "less" means a larger
+    // key or an older version of the same key.
+    auto less = [&](size_t a, size_t b) {
+        int cmp = iterators[a]->key().compare(iterators[b]->key());
+        return cmp > 0 or (cmp == 0 and iterators[a]->sequence() < iterators[b]->sequence());
+    };
+
+    std::vector<size_t> heap;
+    for (size_t i = 0; i < iterators.size(); ++i) {
+        if (in_range(i)) {
+            heap.push_back(i);
         }
+    }
+    std::make_heap(heap.begin(), heap.end(), less);
 
-        if (kv_pair_a.empty() and kv_pair_b.empty()) {
-            break;
+    auto advance = [&](size_t i) {
+        iterators[i]->next();
+        if (in_range(i)) {
+            heap.push_back(i);
+            std::push_heap(heap.begin(), heap.end(), less);
+        }
+    };
+
+    sst_writer writer(path);
+    std::unique_ptr<value_log_writer> values;
+    std::set<uint64_t> gc_files = vlog != nullptr ? vlog->get_gc_files() : std::set<uint64_t>();
+    std::vector<uint64_t> key_hashes;
+    std::optional<std::string> last_key;
+    bool key_added{false};
+    size_t last_stripe{SIZE_MAX};
+    // Whether the newest version of the current stripe is deleted.
+    bool stripe_deleted{false};
+
+    while (not heap.empty()) {
+        std::pop_heap(heap.begin(), heap.end(), less);
+        size_t i = heap.back();
+        heap.pop_back();
+
+        std::string_view key = iterators[i]->key();
+        uint64_t sequence = iterators[i]->sequence();
+        kv_pair::record_type type = iterators[i]->type();
+        size_t stripe = snapshot_list::stripe(sequence, snapshots);
+        // A dropped pointer frees its value in the value log.
+        uint64_t record_bytes = key.size() + (type == kv_pair::VALUE_POINTER ? value_pointer::decode(iterators[i]->value()).size
+                                                                             : iterators[i]->value().size());
+
+        if (not last_key.has_value() or key != last_key.value()) {
+            last_key = std::string(key);
+            key_added = false;
+            last_stripe = SIZE_MAX;
         }
 
-        if (kv_pair_a.empty() and not kv_pair_b.empty()) {
-            min_kv_pair = kv_pair_b;
-            line_b.clear();
-        } else if (not kv_pair_a.empty() and kv_pair_b.empty()) {
-            min_kv_pair = kv_pair_a;
-            line_a.clear();
+        if (stripe == last_stripe) {
+            // Hidden by the newest version of the stripe.
+            if (stripe_deleted) {
+                ++dropped.dropped_versions;
+                dropped.reclaimed_bytes += record_bytes;
+            }
+        } else if (is_covered(tombstones, key, sequence, stripe, snapshots)) {
+            stripe_deleted = true;
+            ++dropped.dropped_versions;
+            dropped.reclaimed_bytes += record_bytes;
+        } else if (bottommost and stripe == 0 and type == kv_pair::DELETE) {
+            stripe_deleted = true;
+            ++dropped.dropped_tombstones;
+            dropped.reclaimed_bytes += record_bytes;
         } else {
-            if (kv_pair_a <= kv_pair_b) {
-                min_kv_pair = kv_pair_a;
-                line_a.clear();
-            } else {
-                min_kv_pair = kv_pair_b;
-                line_b.clear();
+            stripe_deleted = type == kv_pair::DELETE;
+            if (not key_added) {
+                key_hashes.push_back(bloom_filter::hash(key));
+                key_added = true;
             }
-        }
 
-        if (last_key == min_kv_pair.key) {
-            continue;
-        } else {
-            last_key = min_kv_pair.key;
+            std::string_view value = iterators[i]->value();
+            if (type == kv_pair::VALUE_POINTER) {
+                value_pointer pointer = value_pointer::decode(value);
+                if (gc_files.contains(pointer.file_number)) {
+                    value = inputs[i]->value_files.read(value);
+                    type = kv_pair::PUT;
+                } else {
+                    value_files.add(inputs[i]->value_files.get(pointer.file_number), value_log_file::HEADER_SIZE + pointer.size);
+                }
+            }
+            add_record(writer, vlog, values, key, sequence, type, value);
         }
+        last_stripe = stripe;
+        advance(i);
+    }
 
-        //std::cout << "NEXT PAIR: " << min_kv_pair.to_log_entry();
-        bloom.set(min_kv_pair.key);
-
-        if (sparsity_i++ == SPARSITY_FACTOR) {
-            index.insert(rb_entry{min_kv_pair.key, pos});
-            sparsity_i = 0;
-        }
+    finish_sst(writer, values, key_hashes, filters);
+}
 
-        std::string log_entry = min_kv_pair.to_log_entry();
-        merged_sst << log_entry;
+/**
+ * Add a record to the SST. A put of a value the value log separates goes to
+ * the file of this SST in @param values, which is created on the first
+ * such value, and the record only holds the pointer to it.
+ */
+void level::add_record(sst_writer& writer, value_log* vlog, std::unique_ptr<value_log_writer>& values, std::string_view key,
+                       uint64_t sequence, kv_pair::record_type type, std::string_view value) {
+    if (type != kv_pair::PUT or vlog == nullptr or not vlog->is_separated(value)) {
+        writer.add(key, sequence, type, value);
+        return;
+    }
 
-        pos += log_entry.size();
+    if (values == nullptr) {
+        values = vlog->new_writer();
     }
-    merged_sst << std::flush;
+    writer.add(key, sequence, kv_pair::VALUE_POINTER, values->add(value).encode());
 }
 
 /**
- * Iterate over the SST and repopulate the bloom filter and the Sparse Index.
+ * Finish the value log file of the SST, build the bloom filter, write the
+ * filter, properties and value files blocks, finish the SST and map it for
+ * reading. From now on the SST counts as live in its value log files.
  */
-void level::repopulate_bloom_and_index() {
-    std::ifstream sst_file(path, std::ios_base::in);
-    std::string line;
+void level::finish_sst(sst_writer& writer, std::unique_ptr<value_log_writer>& values, const std::vector<uint64_t>& key_hashes,
+                       const filter_allocation& filters) {
+    std::shared_ptr<value_log_file> own_file;
+    uint64_t own_bytes{0};
+    if (values != nullptr) {
+        own_bytes = values->get_file_size();
+        own_file = values->finish();
+        value_files.add(own_file, own_bytes);
+    }
 
-    uint64_t sparsity_i{0};
-    uint64_t pos{0};
+    num_entries = key_hashes.size();
+    bloom = bloom_filter(key_hashes, filters.bits_per_key(get_level_order(), num_entries));
 
-    while (std::getline(sst_file, line)) {
-        kv_pair curr_pair = kv_pair::split_log_entry(line);
-        bloom.set(curr_pair.key);
+    sst_properties properties;
+    properties.num_entries = num_entries;
+    properties.run_id = run_id;
+    properties.max_sequence = max_sequence = std::max(writer.get_max_sequence(), range_tombstones.get_max_sequence());
 
-        if (sparsity_i++ == SPARSITY_FACTOR) {
-            index.insert(rb_entry{curr_pair.key, pos});
-            sparsity_i = 0;
-        }
+    writer.add_meta_block(FILTER_BLOCK, bloom.encode());
+    writer.add_meta_block(PROPERTIES_BLOCK, properties.encode());
+    if (not range_tombstones.empty()) {
+        writer.add_meta_block(RANGE_DEL_BLOCK, range_tombstones.encode());
+    }
+    if (not value_files.empty()) {
+        writer.add_meta_block(VALUE_FILES_BLOCK, value_files.encode());
+    }
+    writer.finish();
+
+    index = fence_pointers(writer.get_index());
+    reader = std::make_unique<sst_reader>(path, cache);
+    value_files.acquire();
+    if (own_file != nullptr) {
+        // The SST took over the count finish() started the file with.
+        own_file->remove_live_bytes(own_bytes);
+    }
+}
 
-        pos += line.size();
+/**
+ * Map the SST and load the bloom filter, the properties and the fence
+ * pointers from their blocks, without touching the data blocks.
+ * Only SSTs written without a filter or properties block are scanned to
+ * rebuild them.
+ */
+void level::repopulate_bloom_and_index(double bits_per_key, const value_log& vlog) {
+    reader = std::make_unique<sst_reader>(path, cache);
+
+    std::optional<block_contents> filter = reader->read_meta_block(FILTER_BLOCK);
+    std::optional<block_contents> properties = reader->read_meta_block(PROPERTIES_BLOCK);
+    std::optional<block_contents> tombstones = reader->read_meta_block(RANGE_DEL_BLOCK);
+    if (tombstones.has_value()) {
+        range_tombstones = range_tombstone_list::decode(tombstones.value().data);
     }
+    std::optional<block_contents> files = reader->read_meta_block(VALUE_FILES_BLOCK);
+    if (files.has_value()) {
+        value_files = value_file_set::decode(files.value().data, vlog);
+        value_files.acquire();
+    }
+
+    run_id = extract_id_level_from_path(path).first;
+
+    if (filter.has_value() and properties.has_value()) {
+        sst_properties decoded = sst_properties::decode(properties.value().data);
+        bloom = bloom_filter(filter.value().data);
+        num_entries = decoded.num_entries;
+        max_sequence = decoded.max_sequence;
+        if (decoded.run_id != 0) {
+            run_id = decoded.run_id;
+        }
+    } else {
+        std::vector<uint64_t> key_hashes;
+        std::string last_key;
+        for (sst_iterator it(*reader); it.valid(); it.next()) {
+            if (key_hashes.empty() or it.key() != last_key) {
+                key_hashes.push_back(bloom_filter::hash(it.key()));
+                last_key.assign(it.key());
+            }
+            max_sequence = std::max(max_sequence, it.sequence());
+        }
+        bloom = bloom_filter(key_hashes, bits_per_key);
+        num_entries = key_hashes.size();
+        max_sequence = std::max(max_sequence, range_tombstones.get_max_sequence());
+    }
+
+    index = fence_pointers(reader->read_index());
 }
 
 /**
  * Collect all stored segment files in @param path and return a list of all segments
  * with its respectful level hierarchy.
  * Retrieve the level of its segment based on the filename.
+ * Temporary files of SSTs that were never finished are deleted. If an SST
+ * can not be read, the ones read already keep their files.
  * Return the segment and the largest ID.
  */
-std::pair<uint16_t, std::list<std::pair<uint32_t, std::vector<level*>>>>
-    level::collect_levels(const std::string &path, uint64_t memtable_size) {
+std::pair<uint64_t, segment_list>
+    level::collect_levels(const std::string &path, double bits_per_key, block_cache* cache, const value_log& vlog) {
 
-    std::map<uint16_t, std::vector<level*>> cache{};
+    std::map<uint16_t, std::vector<std::shared_ptr<level>>> levels_by_order{};
 
-    uint16_t largest_id{0};
+    uint64_t largest_id{0};
 
-    for (const auto& segment_file : std::filesystem::directory_iterator(path)) {
-        std::string segment_path = segment_file.path().string();
-        auto id_level = extract_id_level_from_path(segment_path);
+    try {
+        for (const auto& segment_file : std::filesystem::directory_iterator(path)) {
+            if (segment_file.path().extension() == sst_writer::TEMP_SUFFIX) {
+                // Flush or merge output that was not finished before a crash.
+                std::filesystem::remove(segment_file.path());
+                continue;
+            }
+            std::string segment_path = segment_file.path().string();
+            auto id_level = extract_id_level_from_path(segment_path);
 
-        largest_id = std::max(largest_id, id_level.first);
-        uint16_t level_order = id_level.second;
+            largest_id = std::max(largest_id, id_level.first);
+            uint16_t level_order = id_level.second;
 
-        auto* sst = new level(segment_path, (long) memtable_size * (level_order + 1) * 2);
+            auto sst = std::make_shared<level>(segment_path, bits_per_key, cache, vlog);
 
-        if (cache.contains(level_order)) {
-            cache[level_order].push_back(sst);
-        } else {
-            cache[level_order] = {sst};
+            if (levels_by_order.contains(level_order)) {
+                levels_by_order[level_order].push_back(sst);
+            } else {
+                levels_by_order[level_order] = {sst};
+            }
         }
+    } catch (...) {
+        for (const auto& [level_order, ssts] : levels_by_order) {
+            for (const auto& sst : ssts) {
+                sst->keep_file();
+            }
+        }
+        throw;
     }
 
-    std::list<std::pair<uint32_t, std::vector<level*>>> segments;
-    for (const auto& sst : cache) {
+    segment_list segments;
+    for (auto& sst : levels_by_order) {
+        sort_restored(sst.second);
         segments.emplace_back(sst);
     }
 
     return {largest_id, segments};
 }
 
+/**
+ * Restore the order of the SSTs of one level: runs oldest first, the SSTs
+ * of a run by their keys. Ids do not give this order, a compaction into the
+ * oldest runs of a level and a rewrite by the value log GC write SSTs with
+ * new ids in front of or inside older runs. The runs of a level hold
+ * disjoint ranges of sequence numbers, so their newest one orders them.
+ */
+void level::sort_restored(std::vector<std::shared_ptr<level>>& ssts) {
+    std::map<uint64_t, uint64_t> run_max_sequence;
+    for (const auto& sst : ssts) {
+        uint64_t& max = run_max_sequence[sst->run_id];
+        max = std::max(max, sst->max_sequence);
+    }
+
+    std::sort(ssts.begin(), ssts.end(), [&](const auto& a, const auto& b) {
+        if (a->run_id != b->run_id) {
+            return std::make_pair(run_max_sequence[a->run_id], a->run_id) < std::make_pair(run_max_sequence[b->run_id], b->run_id);
+        }
+        return a->get_smallest_key() < b->get_smallest_key();
+    });
+}
+
+/**
+ * Smallest key of the records and range tombstones of the SST.
+ */
+std::string_view level::get_smallest_key() const {
+    std::optional<std::string_view> smallest;
+    if (index.size() > 0) {
+        smallest = index.key_at(0);
+    }
+    for (const auto& tombstone : range_tombstones.get_tombstones()) {
+        if (not smallest.has_value() or tombstone.begin < smallest.value()) {
+            smallest = tombstone.begin;
+        }
+    }
+    return smallest.value_or(std::string_view());
+}
+
+/**
+ * Whether the SST points into any of the value log files with @param
+ * value_file_numbers.
+ */
+bool level::points_into(const std::set<uint64_t>& value_file_numbers) const {
+    return value_files.refers_to_any(value_file_numbers);
+}
+
+/**
+ * Leave the segment file on disk when the level is destroyed, so a closed
+ * tree can be restored from it.
+ */
+void level::keep_file() {
+    file_kept.store(true, std::memory_order_relaxed);
+}
+
 void level::delete_segment_file() {
     std::filesystem::remove(path);
 }
 
+/**
+ * Split the key space of @param inputs into up to @param num_ranges ranges
+ * holding about the same number of data blocks, and return the boundaries
+ * between them. The first keys of the data blocks serve as candidates.
+ */
+std::vector<std::string> level::split_key_range(const std::vector<std::shared_ptr<level>>& inputs, size_t num_ranges) {
+    std::vector<std::string_view> block_keys;
+    for (const auto& input : inputs) {
+        for (size_t i = 0; i < input->index.size(); ++i) {
+            block_keys.push_back(input->index.key_at(i));
+        }
+    }
+    std::sort(block_keys.begin(), block_keys.end());
+    block_keys.erase(std::unique(block_keys.begin(), block_keys.end()), block_keys.end());
+
+    std::vector<std::string> boundaries;
+    for (size_t i = 1; i < num_ranges; ++i) {
+        size_t pos = i * block_keys.size() / num_ranges;
+        // Skip the smallest key, the first range would be empty.
+        if (pos == 0 or (not boundaries.empty() and boundaries.back() == block_keys[pos])) {
+            continue;
+        }
+        boundaries.emplace_back(block_keys[pos]);
+    }
+    return boundaries;
+}
+
 void level::delete_all_segments(const std::string &path) {
     for (const auto& entry : std::filesystem::directory_iterator(path))
         std::filesystem::remove_all(entry.path());
@@ -2,51 +2,138 @@
 #define LEVEL_H
 
 #include "../../bloom_filter/bloom.hpp"
-#include "../../red_black_tree/red_black.hpp"
+#include "../../bloom_filter/filter_allocation.hpp"
+#include "../../memtable/skiplist_memtable.hpp"
 #include "../../utils/types.hpp"
+#include "../../sst/format.hpp"
+#include "../../sst/sst_reader.hpp"
+#include "../../sst/sst_writer.hpp"
+#include "../../cache/block_cache.hpp"
+#include "../../utils/cursor.hpp"
+#include "../../utils/range_tombstones.hpp"
+#include "../../vlog/value_log.hpp"
+#include "../snapshot.hpp"
+#include "fence_pointers.hpp"
+#include <atomic>
 #include <string>
 #include <queue>
 #include <ios>
 #include <filesystem>
+#include <memory>
+#include <optional>
+#include <list>
+#include <set>
+#include <vector>
+
+class level;
+
+// Levels ordered from the top, every level holds its SSTs oldest first.
+// SSTs are shared, an SST replaced by a compaction stays readable, and its
+// file stays on disk, until the last reader drops it.
+using segment_list = std::list<std::pair<uint32_t, std::vector<std::shared_ptr<level>>>>;
+
+/**
+ * Half-open key range [lower, upper), a missing bound is unbounded.
+ */
+struct key_range {
+    std::optional<std::string> lower;
+    std::optional<std::string> upper;
+};
 
 class level {
 
     public:
-        level(const std::string &path, long bloom_size, red_black_tree &memtable);
+        // What a merge dropped because it was deleted, or was a delete with
+        // nothing left to delete.
+        struct drop_stats {
+            uint64_t dropped_tombstones{0};
+            uint64_t dropped_versions{0};
+            uint64_t reclaimed_bytes{0};
+        };
+
+        level(const std::string &path, const filter_allocation& filters, const skiplist_memtable &memtable,
+              const std::vector<uint64_t>& snapshots, block_cache* cache, value_log* vlog);
 
-        level(const std::string &path, level* sst_a, level* sst_b, long bloom_size);
+        level(const std::string &path, const std::vector<std::shared_ptr<level>>& inputs, const key_range& range, uint64_t run_id,
+              bool bottommost, const filter_allocation& filters, const std::vector<uint64_t>& snapshots, block_cache* cache,
+              value_log* vlog);
 
-        level(const std::string &path, long bloom_size);
+        level(const std::string &path, double bits_per_key, block_cache* cache, const value_log& vlog);
 
         ~level();
 
-        std::optional<std::string> search(const std::string& target) const;
+        std::optional<key_version> search(const std::string& target, uint64_t sequence) const;
+
+        std::vector<std::optional<key_version>>
+            multi_search(const std::vector<std::string_view>& targets, const std::vector<uint64_t>& hashes, uint64_t sequence) const;
+
+        std::unique_ptr<cursor> new_cursor(uint64_t sequence) const;
 
         static std::string
-            create_filename_based_on_level(uint16_t id, uint16_t level_order);
+            create_filename_based_on_level(uint64_t id, uint16_t level_order);
 
-        static std::pair<uint16_t, uint16_t>
+        static std::pair<uint64_t, uint16_t>
             extract_id_level_from_path(const std::string& path);
 
-        static std::pair<uint16_t, std::list<std::pair<uint32_t, std::vector<level*>>>>
-            collect_levels(const std::string& path, uint64_t memtable_size);
+        static std::pair<uint64_t, segment_list>
+            collect_levels(const std::string& path, double bits_per_key, block_cache* cache, const value_log& vlog);
 
         static void delete_all_segments(const std::string& path);
 
+        static std::vector<std::string> split_key_range(const std::vector<std::shared_ptr<level>>& inputs, size_t num_ranges);
+
         std::string get_name() const;
 
-    private:
-        static const uint64_t SPARSITY_FACTOR{128};
+        uint16_t get_level_order() const;
+
+        uint64_t get_num_entries() const;
+
+        uint64_t get_file_size() const;
+
+        uint64_t get_run_id() const;
+
+        uint64_t get_max_sequence() const;
 
+        const range_tombstone_list& get_range_tombstones() const;
+
+        const drop_stats& get_drop_stats() const;
+
+        bool points_into(const std::set<uint64_t>& value_file_numbers) const;
+
+        void keep_file();
+
+    private:
         std::string path;
+        block_cache* cache;
         bloom_filter bloom;
-        red_black_tree index;
+        fence_pointers index;
+        uint64_t num_entries{0};
+        uint64_t run_id{0};
+        uint64_t max_sequence{0};
+        range_tombstone_list range_tombstones;
+        value_file_set value_files;
+        drop_stats dropped;
+        std::unique_ptr<sst_reader> reader;
+        // Set when the tree is closed, the file then outlives the object.
+        std::atomic<bool> file_kept{false};
+
+        void create_sst_from_memtable(const skiplist_memtable& memtable, const filter_allocation& filters,
+                                      const std::vector<uint64_t>& snapshots, value_log* vlog);
+
+        void merge_sst_values(const std::vector<std::shared_ptr<level>>& inputs, const key_range& range, bool bottommost,
+                              const filter_allocation& filters, const std::vector<uint64_t>& snapshots, value_log* vlog);
+
+        void add_record(sst_writer& writer, value_log* vlog, std::unique_ptr<value_log_writer>& values, std::string_view key,
+                        uint64_t sequence, kv_pair::record_type type, std::string_view value);
+
+        void finish_sst(sst_writer& writer, std::unique_ptr<value_log_writer>& values, const std::vector<uint64_t>& key_hashes,
+                        const filter_allocation& filters);
 
-        void create_sst_from_memtable(red_black_tree& memtable);
+        void repopulate_bloom_and_index(double bits_per_key, const value_log& vlog);
 
-        void merge_sst_values(level* sst_a, level* sst_b);
+        std::string_view get_smallest_key() const;
 
-        void repopulate_bloom_and_index();
+        static void sort_restored(std::vector<std::shared_ptr<level>>& ssts);
 
         void delete_segment_file();
 };
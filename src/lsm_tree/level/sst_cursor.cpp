@@ -0,0 +1,142 @@
+#include "sst_cursor.hpp"
+#include <algorithm>
+
+sst_cursor::sst_cursor(const sst_reader& reader, const fence_pointers& index, const value_file_set& value_files, uint64_t sequence)
+        : reader(reader), index(index), value_files(value_files), snapshot(sequence) {}
+
+bool sst_cursor::valid() const {
+    return is_valid;
+}
+
+void sst_cursor::seek_to_first() {
+    load_block(0);
+    record_i = 0;
+    skip_empty_blocks_forward();
+}
+
+void sst_cursor::seek_to_last() {
+    if (index.size() == 0) {
+        is_valid = false;
+        return;
+    }
+    load_block(index.size() - 1);
+    record_i = records.size();
+    skip_empty_blocks_backward();
+}
+
+/**
+ * Start at the block whose first key is the closest lower neighbour of the
+ * target and binary search its records. If all records are smaller the
+ * first record of the next block is the result.
+ */
+void sst_cursor::seek(std::string_view target) {
+    std::optional<size_t> floor = index.floor(target);
+    load_block(floor.value_or(0));
+
+    auto it = std::lower_bound(records.begin(), records.end(), target, [](const record& curr, std::string_view key) {
+        return curr.key < key;
+    });
+    record_i = std::distance(records.begin(), it);
+    skip_empty_blocks_forward();
+}
+
+void sst_cursor::seek_for_prev(std::string_view target) {
+    std::optional<size_t> floor = index.floor(target);
+    if (not floor.has_value()) {
+        // Target is smaller than the first key of the SST.
+        is_valid = false;
+        return;
+    }
+    load_block(floor.value());
+
+    auto it = std::upper_bound(records.begin(), records.end(), target, [](std::string_view key, const record& curr) {
+        return key < curr.key;
+    });
+    record_i = std::distance(records.begin(), it);
+    skip_empty_blocks_backward();
+}
+
+void sst_cursor::next() {
+    ++record_i;
+    skip_empty_blocks_forward();
+}
+
+void sst_cursor::prev() {
+    skip_empty_blocks_backward();
+}
+
+std::string_view sst_cursor::key() const {
+    return records[record_i].key;
+}
+
+std::string_view sst_cursor::value() const {
+    const record& curr = records[record_i];
+    return curr.type == kv_pair::VALUE_POINTER ? value_files.read(curr.value) : curr.value;
+}
+
+uint64_t sst_cursor::sequence() const {
+    return records[record_i].sequence;
+}
+
+/**
+ * A value pointer is a put to the readers of the cursor.
+ */
+kv_pair::record_type sst_cursor::type() const {
+    return records[record_i].type == kv_pair::VALUE_POINTER ? kv_pair::PUT : records[record_i].type;
+}
+
+/**
+ * Read block @param i and decode the newest visible version of every key.
+ * A cached block stays pinned while the cursor is on it. Missing blocks are
+ * read from the mapping without filling the cache, so a long scan does not
+ * evict the blocks of point lookups.
+ */
+void sst_cursor::load_block(size_t i) {
+    block_i = i;
+    records.clear();
+    if (i >= index.size()) {
+        block = {};
+        return;
+    }
+
+    block = reader.get_block(index.handle_at(i), block_cache::LOW, false);
+    for (block_iterator it(block.data); it.valid(); it.next()) {
+        bool seen = not records.empty() and records.back().key == it.key();
+        if (not seen and it.sequence() <= snapshot) {
+            records.push_back({it.key(), it.value(), it.sequence(), it.type()});
+        }
+    }
+}
+
+/**
+ * Stay on record_i if it exists, otherwise move to the first record of the
+ * next non-empty block.
+ */
+void sst_cursor::skip_empty_blocks_forward() {
+    while (record_i >= records.size()) {
+        if (block_i + 1 >= index.size()) {
+            is_valid = false;
+            return;
+        }
+        load_block(block_i + 1);
+        record_i = 0;
+    }
+    is_valid = true;
+}
+
+/**
+ * Move to the record before record_i, which may be the last record of a
+ * previous block.
+ */
+void sst_cursor::skip_empty_blocks_backward() {
+    while (record_i == 0) {
+        if (block_i == 0 or index.size() == 0) {
+            is_valid = false;
+            return;
+        }
+        load_block(block_i - 1);
+        record_i = records.size();
+    }
+    --record_i;
+    is_valid = true;
+}
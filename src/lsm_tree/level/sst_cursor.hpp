@@ -0,0 +1,74 @@
+#ifndef SST_CURSOR_H
+#define SST_CURSOR_H
+
+#include "../../sst/sst_reader.hpp"
+#include "../../utils/cursor.hpp"
+#include "../../vlog/value_log.hpp"
+#include "fence_pointers.hpp"
+#include <string_view>
+#include <vector>
+
+/**
+ * Bidirectional cursor over an SST. Seeks use the fence pointers to find the
+ * data block, which is read through the block cache and decoded once into
+ * the versions visible at the sequence number of the cursor, so the cursor
+ * can move backwards within the block as well. Since the versions of a key
+ * never span two blocks, every block is resolved on its own.
+ * Values moved to the value log are only read when the cursor is on them.
+ * The reader, the fence pointers and the value files have to outlive the
+ * cursor.
+ */
+class sst_cursor : public cursor {
+
+    public:
+        sst_cursor(const sst_reader& reader, const fence_pointers& index, const value_file_set& value_files, uint64_t sequence);
+
+        bool valid() const override;
+
+        void seek_to_first() override;
+
+        void seek_to_last() override;
+
+        void seek(std::string_view target) override;
+
+        void seek_for_prev(std::string_view target) override;
+
+        void next() override;
+
+        void prev() override;
+
+        std::string_view key() const override;
+
+        std::string_view value() const override;
+
+        uint64_t sequence() const override;
+
+        kv_pair::record_type type() const override;
+
+    private:
+        struct record {
+            std::string_view key;
+            std::string_view value;
+            uint64_t sequence;
+            kv_pair::record_type type;
+        };
+
+        const sst_reader& reader;
+        const fence_pointers& index;
+        const value_file_set& value_files;
+        uint64_t snapshot;
+
+        size_t block_i{0};
+        block_contents block;
+        std::vector<record> records;
+        size_t record_i{0};
+        bool is_valid{false};
+
+        void load_block(size_t i);
+
+        void skip_empty_blocks_forward();
+
+        void skip_empty_blocks_backward();
+};
+
+#endif // SST_CURSOR_H
@@ -0,0 +1,161 @@
+#include "lsm_iterator.hpp"
+#include <algorithm>
+
+/**
+ * @param memtables and @param ssts are ordered newest first, the iterator
+ * reads them at @param sequence. Only range tombstones visible at the
+ * sequence number are collected.
+ */
+lsm_iterator::lsm_iterator(const std::vector<std::shared_ptr<skiplist_memtable>>& memtables,
+                           const std::vector<std::shared_ptr<level>>& ssts, uint64_t sequence, direction dir)
+        : dir(dir), sequence(sequence), memtables(memtables), ssts(ssts) {
+    std::vector<range_tombstone> visible;
+    auto collect = [&](const range_tombstone_list& list) {
+        for (const range_tombstone& tombstone : list.get_tombstones()) {
+            if (tombstone.sequence <= sequence) {
+                visible.push_back(tombstone);
+            }
+        }
+    };
+
+    for (const auto& table : memtables) {
+        cursors.push_back(table->new_cursor(sequence));
+        max_sequences.push_back(UINT64_MAX);
+        std::shared_ptr<const range_tombstone_list> table_tombstones = table->get_range_tombstones();
+        if (table_tombstones != nullptr) {
+            collect(*table_tombstones);
+        }
+    }
+    for (const auto& sst : ssts) {
+        cursors.push_back(sst->new_cursor(sequence));
+        max_sequences.push_back(sst->get_max_sequence());
+        collect(sst->get_range_tombstones());
+    }
+    tombstones = range_tombstone_list(std::move(visible));
+}
+
+bool lsm_iterator::valid() const {
+    return not heap.empty();
+}
+
+void lsm_iterator::seek_to_first() {
+    for (auto& c : cursors) {
+        dir == FORWARD ? c->seek_to_first() : c->seek_to_last();
+    }
+    build_heap();
+    skip_deleted();
+}
+
+void lsm_iterator::seek(std::string_view target) {
+    for (auto& c : cursors) {
+        dir == FORWARD ? c->seek(target) : c->seek_for_prev(target);
+    }
+    build_heap();
+    skip_deleted();
+}
+
+void lsm_iterator::next() {
+    skip_key();
+    skip_deleted();
+}
+
+std::string_view lsm_iterator::key() const {
+    return cursors[heap.front()]->key();
+}
+
+std::string_view lsm_iterator::value() const {
+    return cursors[heap.front()]->value();
+}
+
+/**
+ * Heap order: the next key in scan direction comes first, and for equal
+ * keys the newer source.
+ */
+bool lsm_iterator::lower_priority(size_t a, size_t b) const {
+    int cmp = cursors[a]->key().compare(cursors[b]->key());
+    if (cmp == 0) {
+        return a > b;
+    }
+    return dir == FORWARD ? cmp > 0 : cmp < 0;
+}
+
+void lsm_iterator::build_heap() {
+    heap.clear();
+    for (size_t i = 0; i < cursors.size(); ++i) {
+        if (cursors[i]->valid()) {
+            heap.push_back(i);
+        }
+    }
+
+    auto cmp = [this](size_t a, size_t b) { return lower_priority(a, b); };
+    std::make_heap(heap.begin(), heap.end(), cmp);
+}
+
+/**
+ * Move every cursor positioned at the current key past it, which drops the
+ * older versions of the key.
+ */
+void lsm_iterator::skip_key() {
+    auto cmp = [this](size_t a, size_t b) { return lower_priority(a, b); };
+    // The key is copied since it dies once its cursor moves.
+    std::string curr_key(key());
+
+    while (not heap.empty() and cursors[heap.front()]->key() == curr_key) {
+        std::pop_heap(heap.begin(), heap.end(), cmp);
+        size_t i = heap.back();
+        heap.pop_back();
+
+        dir == FORWARD ? cursors[i]->next() : cursors[i]->prev();
+        if (cursors[i]->valid()) {
+            heap.push_back(i);
+            std::push_heap(heap.begin(), heap.end(), cmp);
+        }
+    }
+}
+
+/**
+ * Move past the current key, which the fragment @param frag deletes with
+ * the tombstone @param covering. Sources whose versions are all older than
+ * the tombstone seek past the rest of the fragment, the others only move
+ * past the current key.
+ */
+void lsm_iterator::skip_fragment(const range_tombstone_list::fragment& frag, uint64_t covering) {
+    std::string curr_key(key());
+
+    for (size_t i : heap) {
+        cursor& c = *cursors[i];
+        if (max_sequences[i] < covering) {
+            if (dir == FORWARD and c.key() < frag.end) {
+                c.seek(frag.end);
+            } else if (dir == REVERSE and c.key() >= frag.begin) {
+                c.seek_for_prev(frag.begin);
+                if (c.valid() and c.key() == frag.begin) {
+                    c.prev();
+                }
+            }
+        } else if (c.key() == curr_key) {
+            dir == FORWARD ? c.next() : c.prev();
+        }
+    }
+    build_heap();
+}
+
+/**
+ * Skip keys whose newest visible version is a delete or older than a range
+ * tombstone covering the key.
+ */
+void lsm_iterator::skip_deleted() {
+    while (valid()) {
+        const cursor& top = *cursors[heap.front()];
+        const range_tombstone_list::fragment* frag = tombstones.empty() ? nullptr : tombstones.find(top.key());
+        uint64_t covering = frag == nullptr ? 0 : range_tombstone_list::newest_visible(*frag, sequence);
+
+        if (top.sequence() < covering) {
+            skip_fragment(*frag, covering);
+        } else if (top.type() == kv_pair::DELETE) {
+            skip_key();
+        } else {
+            return;
+        }
+    }
+}
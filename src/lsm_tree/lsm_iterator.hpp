@@ -0,0 +1,77 @@
+#ifndef LSM_ITERATOR_H
+#define LSM_ITERATOR_H
+
+#include "../memtable/skiplist_memtable.hpp"
+#include "../utils/cursor.hpp"
+#include "../utils/range_tombstones.hpp"
+#include "level/level.hpp"
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Ordered scan over the memtables and all SSTs, forward or in reverse.
+ * Every source gets a cursor and a heap yields the smallest (largest when
+ * reversed) key across all of them. Sources are ordered newest first, so
+ * for a key held by several sources only the newest version is returned,
+ * and keys whose newest version is a delete are skipped.
+ * The range tombstones of all sources are merged into one list. A key they
+ * delete is skipped, and sources whose versions are all older than the
+ * covering tombstone jump over the rest of its range with one seek, so a
+ * deleted range costs a seek per source instead of a step per key.
+ * The iterator shares ownership of the memtables and SSTs it was created
+ * on and only sees versions up to its sequence number, so it reads a
+ * consistent state no matter what is written, flushed or compacted in the
+ * meantime.
+ */
+class lsm_iterator {
+
+    public:
+        enum direction {
+            FORWARD,
+            REVERSE
+        };
+
+        lsm_iterator(const std::vector<std::shared_ptr<skiplist_memtable>>& memtables,
+                     const std::vector<std::shared_ptr<level>>& ssts, uint64_t sequence, direction dir);
+
+        bool valid() const;
+
+        // Position at the first key, or at the last key when reversed.
+        void seek_to_first();
+
+        // Position at the first key >= target, or at the last key <= target
+        // when reversed.
+        void seek(std::string_view target);
+
+        void next();
+
+        std::string_view key() const;
+
+        std::string_view value() const;
+
+    private:
+        direction dir;
+        uint64_t sequence;
+        std::vector<std::shared_ptr<skiplist_memtable>> memtables;
+        std::vector<std::shared_ptr<level>> ssts;
+        // Newest source first.
+        std::vector<std::unique_ptr<cursor>> cursors;
+        // Largest sequence number of every source, UINT64_MAX for memtables.
+        std::vector<uint64_t> max_sequences;
+        std::vector<size_t> heap;
+        range_tombstone_list tombstones;
+
+        bool lower_priority(size_t a, size_t b) const;
+
+        void build_heap();
+
+        void skip_key();
+
+        void skip_fragment(const range_tombstone_list::fragment& frag, uint64_t covering);
+
+        void skip_deleted();
+};
+
+#endif // LSM_ITERATOR_H
@@ -1,136 +1,885 @@
 #include "lsm_tree.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <numeric>
 
-lsm_tree::lsm_tree(): memtable(), wal(WAL_PATH) {
-    restore_db();
+namespace {
+
+    /**
+     * A version is visible unless it is a delete or a range tombstone with
+     * the larger sequence number @param covering deletes it.
+     */
+    bool is_visible(const key_version& found, uint64_t covering) {
+        return found.type == kv_pair::PUT and found.sequence > covering;
+    }
+
+} // namespace
+
+lsm_tree::lsm_tree(const lsm_options& options)
+        : options(options),
+          wal_dir((std::filesystem::path(options.directory) / "wal" / "").string()),
+          segment_dir((std::filesystem::path(options.directory) / "segments" / "").string()),
+          vlog(std::make_unique<value_log>((std::filesystem::path(options.directory) / "vlog" / "").string(),
+                                           options.value_log_threshold, options.value_log_gc_ratio)),
+          memtable(std::make_shared<skiplist_memtable>()), snapshots(std::make_shared<snapshot_list>()) {
+    if (options.block_cache_size > 0) {
+        cache = std::make_unique<block_cache>(options.block_cache_size, options.block_cache_policy,
+                                              options.block_cache_shard_bits, options.block_cache_high_pri_ratio);
+    }
+    compaction = compaction_policy::create(options.compaction_style, options.compaction_size_ratio, MEMTABLE_SIZE);
+    if (options.max_subcompactions > 1) {
+        subcompaction_pool = std::make_unique<thread_pool>(options.max_subcompactions - 1, options.cpu_affinity);
+    }
+
+    // A tree that fails to open is closed, so the restored data stays on disk.
+    try {
+        install_version();
+        restore_db();
+        install_version();
+        background_thread = std::thread(&lsm_tree::background_flush, this);
+        for (uint32_t i = 0; i < options.compaction_threads; ++i) {
+            compaction_threads.emplace_back(&lsm_tree::background_compaction, this);
+        }
+
+        thread_pool::pin_thread(background_thread, options.cpu_affinity);
+        for (auto& thread : compaction_threads) {
+            thread_pool::pin_thread(thread, options.cpu_affinity);
+        }
+    } catch (...) {
+        close();
+        throw;
+    }
 }
 
 lsm_tree::~lsm_tree() {
+    if (closed) {
+        return;
+    }
+    stop_background_threads();
     drop_table();
 }
 
+/**
+ * Stop the background threads and release the tree without deleting any
+ * of its files, the next lsm_tree on the same directory restores it. The
+ * tree must not be used afterwards, destroying it only closes its files.
+ */
+void lsm_tree::close() {
+    if (closed) {
+        return;
+    }
+    stop_background_threads();
+
+    {
+        std::unique_lock<std::shared_mutex> guard(state_mutex);
+        for (const auto& [level_order, ssts] : segments) {
+            for (const auto& sst : ssts) {
+                sst->keep_file();
+            }
+        }
+    }
+    vlog->keep_files();
+    closed = true;
+}
+
 /**
  * Insert a new kv-pair into the database:
- * 1. If the size of the memtable is greater than MEMTABLE_SIZE, flush the 
- * memtable to the disk and create a new segment with the pairs on disk,
- * and possibly merge multiple segments into one. Reset the WAL.
+ * 1. If the size of the memtable is greater than MEMTABLE_SIZE, swap it into
+ * the immutable slot and continue with a fresh memtable and WAL. The
+ * background thread persists the full memtable.
  * 2. Write kv-pair to WAL.
  * 3. Insert into memtable.
+ * Concurrent puts are committed together, see commit().
  */
 void lsm_tree::put(const std::string& key, const std::string& value) {
-    if (memtable.size() >= MEMTABLE_SIZE) {
-        compact();
-        //std::cout << "FINISHED COMPACTION" << std::endl;
-        flush_memtable_to_disk();
-        //std::cout << "FLUSHED MEMTABLE TO DISK" << std::endl;
-        wal.clear();
-    }
-
-    kv_pair entry = {key, value};
-    wal.append(entry.to_log_entry());
-    memtable.insert(entry);
+    commit({{key, value}});
 }
 
 /**
- * Get a kv-pair from the database.
- * 1. Check if the key is in the memtable.
+ * Get a kv-pair from the database, as of @param snap or the latest write.
+ * 1. Check if the key is in the active or the immutable memtable.
  * 2. If not, check each segment individually.
+ * The newest version found is returned unless it is a delete or a range
+ * tombstone of the same or a newer source deletes it.
  */
-std::string lsm_tree::get(const std::string& key) {
-    std::optional<std::string> memtable_val = memtable.get(key);
-    if (memtable_val.has_value()) {
-        return memtable_val.value() == TOMBSTONE ? "" : memtable_val.value();
+std::string lsm_tree::get(const std::string& key, const snapshot* snap) {
+    std::shared_ptr<const tree_version> version = get_current_version();
+    uint64_t sequence = snap != nullptr ? snap->get_sequence() : last_sequence.load(std::memory_order_acquire);
+    // Newest range tombstone covering the key in the sources searched so far.
+    uint64_t covering{0};
+
+    for (const skiplist_memtable* table : {version->memtable.get(), version->immutable_memtable.get()}) {
+        if (table == nullptr) {
+            continue;
+        }
+        std::shared_ptr<const range_tombstone_list> table_tombstones = table->get_range_tombstones();
+        if (table_tombstones != nullptr) {
+            covering = std::max(covering, table_tombstones->max_covering(key, sequence));
+        }
+        std::optional<key_version> found = table->get(key, sequence);
+        if (found.has_value()) {
+            return is_visible(found.value(), covering) ? found.value().value : "";
+        }
     }
 
-    std::optional<std::string> segment_val = search_all_segments(key);
-    if (segment_val.has_value()) {
-        return segment_val.value() == TOMBSTONE ? "" : segment_val.value();
+    std::optional<key_version> found = search_all_segments(version->segments, key, sequence, covering);
+    if (found.has_value() and is_visible(found.value(), covering)) {
+        return found.value().value;
     }
 
     return "";
 }
 
 /**
- * To remove a value from the database, we just insert the key
- * with the TOMBSTONE value.
+ * Get the values of a batch of keys, in the order of @param keys, as of
+ * @param snap or the latest write.
+ * The keys are sorted and every distinct key is looked up once. Keys not
+ * found in the memtables go through the SSTs together, see
+ * multi_search_all_segments().
+ */
+std::vector<std::string> lsm_tree::multi_get(std::span<const std::string> keys, const snapshot* snap) {
+    std::vector<size_t> order(keys.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&keys](size_t a, size_t b) {
+        return keys[a] < keys[b];
+    });
+
+    std::vector<std::string_view> targets;
+    std::vector<size_t> target_of(keys.size());
+    for (size_t pos : order) {
+        if (targets.empty() or targets.back() != keys[pos]) {
+            targets.push_back(keys[pos]);
+        }
+        target_of[pos] = targets.size() - 1;
+    }
+
+    std::vector<std::optional<key_version>> values(targets.size());
+    std::vector<uint64_t> covering(targets.size(), 0);
+    std::vector<size_t> pending;
+    std::shared_ptr<const tree_version> version = get_current_version();
+    uint64_t sequence = snap != nullptr ? snap->get_sequence() : last_sequence.load(std::memory_order_acquire);
+
+    std::shared_ptr<const range_tombstone_list> table_tombstones[2];
+    const skiplist_memtable* tables[2] = {version->memtable.get(), version->immutable_memtable.get()};
+    for (size_t t = 0; t < 2; ++t) {
+        if (tables[t] != nullptr) {
+            table_tombstones[t] = tables[t]->get_range_tombstones();
+        }
+    }
+
+    for (size_t i = 0; i < targets.size(); ++i) {
+        for (size_t t = 0; t < 2 and tables[t] != nullptr and not values[i].has_value(); ++t) {
+            if (table_tombstones[t] != nullptr) {
+                covering[i] = std::max(covering[i], table_tombstones[t]->max_covering(targets[i], sequence));
+            }
+            values[i] = tables[t]->get(std::string(targets[i]), sequence);
+        }
+        if (not values[i].has_value()) {
+            pending.push_back(i);
+        }
+    }
+
+    multi_search_all_segments(version->segments, targets, pending, values, covering, sequence);
+
+    std::vector<std::string> result(keys.size());
+    for (size_t pos = 0; pos < keys.size(); ++pos) {
+        size_t i = target_of[pos];
+        if (values[i].has_value() and is_visible(values[i].value(), covering[i])) {
+            result[pos] = values[i].value().value;
+        }
+    }
+    return result;
+}
+
+/**
+ * To remove a value from the database, we just insert a DELETE record for
+ * the key.
  * Since we are searching from Memtable -> latest segment, retrieval will find
- * the {key, TOMBSTONE} pair first and knows it got deleted.
+ * the delete first and knows the key got deleted.
  */
 void lsm_tree::remove(const std::string& key) {
-    put(key, TOMBSTONE);
+    commit({{key, "", kv_pair::DELETE}});
+}
+
+/**
+ * Delete all keys in [@param begin, @param end) with a single range
+ * tombstone instead of one delete per key. Reads and compactions check
+ * the tombstone against the sequence numbers of the versions they find.
+ */
+void lsm_tree::delete_range(const std::string& begin, const std::string& end) {
+    if (begin < end) {
+        commit({{begin, end, kv_pair::RANGE_DELETE}});
+    }
+}
+
+/**
+ * Apply all puts and removes of @param batch atomically: the batch is
+ * logged within a single WAL record and inserted into the memtable in one
+ * go.
+ */
+void lsm_tree::write(const write_batch& batch) {
+    if (batch.count() > 0) {
+        commit(batch.get_entries());
+    }
+}
+
+/**
+ * Return an unpositioned iterator over the current memtables and SSTs, as
+ * of @param snap or the latest write. Sources are collected newest first in
+ * the same order get() searches them.
+ */
+lsm_iterator lsm_tree::new_iterator(lsm_iterator::direction dir, const snapshot* snap) {
+    std::vector<std::shared_ptr<skiplist_memtable>> memtables;
+    std::vector<std::shared_ptr<level>> ssts;
+
+    std::shared_ptr<const tree_version> version = get_current_version();
+    uint64_t sequence = snap != nullptr ? snap->get_sequence() : last_sequence.load(std::memory_order_acquire);
+    memtables.push_back(version->memtable);
+    if (version->immutable_memtable != nullptr) {
+        memtables.push_back(version->immutable_memtable);
+    }
+    for (const auto& curr_segment : version->segments) {
+        ssts.insert(ssts.end(), curr_segment.second.rbegin(), curr_segment.second.rend());
+    }
+
+    return lsm_iterator(memtables, ssts, sequence, dir);
+}
+
+/**
+ * Return a snapshot of the latest write. Reads at the snapshot keep seeing
+ * this state until the handle is dropped.
+ */
+std::shared_ptr<const snapshot> lsm_tree::get_snapshot() {
+    return snapshots->create(last_sequence);
 }
 
 /**
  * Clears the Memtable, the WAL, and all SSTs on the disk.
+ * Queued writes, a running background flush and running compactions are
+ * finished first. A background error stays, the failed thread does not
+ * come back.
  */
 void lsm_tree::drop_table() {
-    memtable.delete_tree();
-    wal.clear();
+    writer w(nullptr);
+    std::unique_lock<std::mutex> write_guard(write_mutex);
+    await_turn(w, write_guard);
+    wait_for_flush();
 
-    level::delete_all_segments(SEGMENT_BASE);
-    segments.clear();
-    segment_i = 0;
+    {
+        std::unique_lock<std::shared_mutex> guard(state_mutex);
+        compaction_cv.wait(guard, [this] { return busy_levels.empty(); });
+        // Open iterators keep reading the old memtable.
+        memtable = std::make_shared<skiplist_memtable>();
+        wal->clear();
+        // Only left over by a failed flush.
+        immutable_memtable.reset();
+        if (immutable_wal != nullptr) {
+            immutable_wal->remove();
+            immutable_wal.reset();
+        }
+
+        level::delete_all_segments(segment_dir);
+        // Ids keep counting up: an SST pinned by an open iterator removes
+        // its file once released and must not hit a new SST of the same name.
+        segments.clear();
+        install_version();
+    }
+
+    finish_turn({&w}, nullptr);
+}
+
+block_cache::stats lsm_tree::get_block_cache_stats() const {
+    if (cache == nullptr) {
+        return {};
+    }
+    return cache->get_stats();
+}
+
+compaction_stats lsm_tree::get_compaction_stats() {
+    std::shared_lock<std::shared_mutex> guard(state_mutex);
+    return compaction_totals;
 }
 
 /**
- * Delete the in memory table and store all key values pair in a sorted
- * order in a new segment file.
+ * Commit @param entries as one unit with group commit. The writer queues
+ * up and waits until it reaches the front of the queue or a leader has
+ * already written its entries to the WAL. As the leader it collects the
+ * entries of the writers queued behind it, up to MAX_GROUP_SIZE bytes, and
+ * writes them as one WAL record. The entries of one writer are never split
+ * across records, which makes write batches atomic. The WAL is only used by
+ * the leader, so the lock is released while writing, letting new writers
+ * queue up for the next group.
+ * Once the record is written, every member of the group inserts its own
+ * entries into the memtable concurrently with the others. The entries of
+ * the group get consecutive sequence numbers, and the last member to finish
+ * publishes the last one, so the group becomes visible to reads together.
+ * After a background error the whole group fails with it. A group that
+ * fails while inserting is only partly in the memtable, so it is never
+ * published and becomes the background error.
  */
-void lsm_tree::flush_memtable_to_disk() {
-    auto* sst = new level(get_new_segment_path(0), (long) memtable.size(), memtable);
+void lsm_tree::commit(const std::vector<kv_pair>& entries) {
+    writer w(&entries);
+    write_group group;
+    std::unique_lock<std::mutex> lock(write_mutex);
+    await_turn(w, lock);
 
+    if (not w.done and w.group == nullptr) {
+        std::string payload;
+        write_ahead_log::begin_payload(payload, next_sequence);
+        for (writer* queued : writers) {
+            if (queued->entries == nullptr or (not group.members.empty() and payload.size() >= MAX_GROUP_SIZE)) {
+                break;
+            }
+            group.members.push_back(queued);
+            queued->sequence = next_sequence;
+            for (const kv_pair& entry : *queued->entries) {
+                write_ahead_log::encode_entry(payload, entry);
+            }
+            next_sequence += queued->entries->size();
+        }
+        group.last_sequence = next_sequence - 1;
+        lock.unlock();
+
+        std::exception_ptr error;
+        try {
+            check_background_error();
+            if (memtable->size() >= MEMTABLE_SIZE) {
+                switch_memtable();
+            }
+            try {
+                wal->append(payload);
+            } catch (...) {
+                // The log may have lost acknowledged records and refuses
+                // further appends, and so does the tree.
+                record_background_error(std::current_exception());
+                throw;
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        if (error) {
+            // Nothing reached the memtable, the skipped sequence numbers
+            // are never used.
+            finish_turn(group.members, error);
+        } else {
+            group.table = memtable.get();
+            group.pending = group.members.size();
+            for (writer* member : group.members) {
+                member->group = &group;
+                member->cv.notify_one();
+            }
+        }
+    }
+
+    if (not w.done) {
+        lock.unlock();
+        std::exception_ptr error;
+        try {
+            w.group->table->insert(*w.entries, w.sequence);
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        lock.lock();
+        finish_insert(*w.group, error);
+        // The leader has to wait as well, its group lives on its stack.
+        w.cv.wait(lock, [&] { return w.done; });
+    }
+
+    if (w.error) {
+        std::rethrow_exception(w.error);
+    }
+}
+
+/**
+ * Queue up @param w and wait until it is at the front of the queue, has to
+ * insert its entries for a leader, or was failed by a leader.
+ */
+void lsm_tree::await_turn(writer& w, std::unique_lock<std::mutex>& lock) {
+    writers.push_back(&w);
+    w.cv.wait(lock, [&] { return w.done or w.group != nullptr or writers.front() == &w; });
+}
+
+/**
+ * Count down the members of @param group that still insert into the
+ * memtable. The last one publishes the sequence numbers of the group if all
+ * inserts succeeded and releases the group. The caller has to hold
+ * write_mutex.
+ */
+void lsm_tree::finish_insert(write_group& group, std::exception_ptr error) {
+    if (error and not group.error) {
+        group.error = error;
+    }
+    if (--group.pending > 0) {
+        return;
+    }
+
+    if (group.error) {
+        record_background_error(group.error);
+    } else {
+        last_sequence.store(group.last_sequence, std::memory_order_release);
+    }
+    finish_turn(group.members, group.error);
+}
+
+/**
+ * Remove the @param group from the front of the queue, release its members
+ * in order and wake up the next leader. The caller has to hold write_mutex.
+ */
+void lsm_tree::finish_turn(const std::vector<writer*>& group, std::exception_ptr error) {
+    for (writer* member : group) {
+        writers.pop_front();
+        member->done = true;
+        member->error = error;
+        member->cv.notify_one();
+    }
+    if (not writers.empty()) {
+        writers.front()->cv.notify_one();
+    }
+}
+
+/**
+ * Move the full memtable and its WAL into the immutable slot and start a new
+ * memtable with a new WAL. If the previous immutable memtable is still being
+ * flushed, the writer waits for it, which throttles writes to the speed of
+ * the disk, or fails if the flush failed. The caller has to be the leader of
+ * the writer queue.
+ */
+void lsm_tree::switch_memtable() {
+    wait_for_flush();
+    check_background_error();
+    // A sync of the full log that failed in the background fails the tree
+    // before a fresh log hides it.
+    if (std::exception_ptr error = wal->get_failure()) {
+        record_background_error(error);
+        std::rethrow_exception(error);
+    }
+
+    auto new_wal = open_wal(wal_i++);
+    {
+        std::unique_lock<std::shared_mutex> guard(state_mutex);
+        immutable_memtable = std::move(memtable);
+        immutable_wal = std::move(wal);
+        memtable = std::make_shared<skiplist_memtable>();
+        wal = std::move(new_wal);
+        install_version();
+    }
+    flush_cv.notify_all();
+}
+
+/**
+ * Let the flush and compaction threads finish their pending work and join
+ * them.
+ */
+void lsm_tree::stop_background_threads() {
+    {
+        std::unique_lock<std::shared_mutex> guard(state_mutex);
+        stop_background = true;
+    }
+    flush_cv.notify_all();
+    compaction_cv.notify_all();
+    if (background_thread.joinable()) {
+        background_thread.join();
+    }
+    for (auto& thread : compaction_threads) {
+        thread.join();
+    }
+    compaction_threads.clear();
+}
+
+/**
+ * Keep the first error of a background thread and wake up everybody
+ * waiting on background work, which will not finish anymore.
+ */
+void lsm_tree::record_background_error(std::exception_ptr error) {
+    {
+        std::unique_lock<std::shared_mutex> guard(state_mutex);
+        if (not background_error) {
+            background_error = error;
+        }
+    }
+    flush_cv.notify_all();
+    compaction_cv.notify_all();
+}
+
+/**
+ * Throw the background error, if there is one.
+ */
+void lsm_tree::check_background_error() {
+    std::shared_lock<std::shared_mutex> guard(state_mutex);
+    if (background_error) {
+        std::rethrow_exception(background_error);
+    }
+}
+
+/**
+ * Publish the current memtables and segments as the version new reads
+ * start from. The caller has to hold state_mutex exclusively.
+ */
+void lsm_tree::install_version() {
+    auto version = std::make_shared<const tree_version>(tree_version{memtable, immutable_memtable, segments});
+    std::lock_guard<std::mutex> guard(version_mutex);
+    current_version.swap(version);
+}
+
+/**
+ * Pin the current version. The mutex is only held to copy the pointer, the
+ * replaced version is released by install_version outside of it.
+ */
+std::shared_ptr<const tree_version> lsm_tree::get_current_version() {
+    std::lock_guard<std::mutex> guard(version_mutex);
+    return current_version;
+}
+
+/**
+ * Block until the immutable slot is empty or the flush failed.
+ */
+void lsm_tree::wait_for_flush() {
+    std::unique_lock<std::shared_mutex> guard(state_mutex);
+    flush_cv.wait(guard, [this] { return immutable_memtable == nullptr or background_error; });
+}
+
+/**
+ * Body of the flush thread: wait for an immutable memtable, write it to a
+ * new SST and delete its WAL once the SST is durable. Pending work is
+ * finished before the thread stops.
+ * If the flush fails, the memtable stays readable in the immutable slot and
+ * its WAL is kept for recovery. The thread stops and writes fail from now
+ * on.
+ */
+void lsm_tree::background_flush() {
+    while (true) {
+        std::shared_ptr<skiplist_memtable> table;
+        {
+            std::unique_lock<std::shared_mutex> guard(state_mutex);
+            flush_cv.wait(guard, [this] { return immutable_memtable != nullptr or stop_background; });
+            if (immutable_memtable == nullptr) {
+                return;
+            }
+            table = immutable_memtable;
+        }
+
+        try {
+            flush_memtable_to_disk(*table);
+        } catch (...) {
+            record_background_error(std::current_exception());
+            return;
+        }
+
+        std::unique_ptr<write_ahead_log> retired_wal;
+        {
+            std::unique_lock<std::shared_mutex> guard(state_mutex);
+            immutable_memtable.reset();
+            retired_wal = std::move(immutable_wal);
+            install_version();
+        }
+        retired_wal->remove();
+        if (std::exception_ptr error = retired_wal->get_failure()) {
+            record_background_error(error);
+        }
+        flush_cv.notify_all();
+        compaction_cv.notify_all();
+    }
+}
+
+/**
+ * Store all key values pairs of @param table in a sorted order in a new
+ * segment file and publish it on level 0.
+ */
+void lsm_tree::flush_memtable_to_disk(const skiplist_memtable& table) {
+    std::shared_lock<std::shared_mutex> read_guard(state_mutex);
+    filter_allocation filters = get_filter_allocation();
+    read_guard.unlock();
+
+    auto sst = std::make_shared<level>(get_new_segment_path(0), filters, table, snapshots->get_sequences(), cache.get(), vlog.get());
+
+    std::unique_lock<std::shared_mutex> guard(state_mutex);
     if (not segments.empty() and segments.front().first == 0) {
         segments.front().second.push_back(sst);
     } else {
         segments.push_front({0, {sst}});
     }
+    install_version();
 }
 
 /**
- * Merge multiple segments into one.
- * Start with level i = 0 (smallest SST) and merge 2 SSTs at each level and
- * push the merged one to the next level i + 1.
+ * Body of a compaction thread: let the policy pick the most urgent job on
+ * levels nobody else is compacting, merge it without holding the lock and
+ * publish the result.
+ * A running job is finished before the thread stops. A failed job leaves
+ * its inputs in place and becomes the background error, after which no
+ * thread starts another job.
  */
-void lsm_tree::compact() {
-    auto it = segments.begin();
+void lsm_tree::background_compaction() {
+    std::unique_lock<std::shared_mutex> guard(state_mutex);
+    while (true) {
+        std::optional<compaction_job> job;
+        compaction_cv.wait(guard, [&] {
+            return stop_background or background_error or (job = compaction->pick(segments, busy_levels)).has_value();
+        });
+        if (not job.has_value()) {
+            return;
+        }
 
-    while (it != segments.end()) {
-        auto& curr_level = it->first;
-        auto& level_segments = it->second;
+        busy_levels.insert(job->level_order);
+        busy_levels.insert(job->target_level);
+        filter_allocation filters = get_filter_allocation(job->inputs);
+        // Collected after the inputs are fixed, see snapshot_list::create().
+        std::vector<uint64_t> snapshot_sequences = snapshots->get_sequences();
 
-        while (level_segments.size() >= 2) {
-            level* sst_a = level_segments.back();
-            level_segments.pop_back();
+        guard.unlock();
+        try {
+            run_compaction(job.value(), filters, snapshot_sequences);
+        } catch (...) {
+            record_background_error(std::current_exception());
+        }
+        guard.lock();
 
-            level* sst_b = level_segments.back();
-            level_segments.pop_back();
+        busy_levels.erase(job->level_order);
+        busy_levels.erase(job->target_level);
 
-            auto* merged = new level(get_new_segment_path(curr_level + 1), sst_a, sst_b, (long) memtable.size() * (curr_level + 1) * 2);
+        // The next level got a new SST and might need compaction now.
+        compaction_cv.notify_all();
+    }
+}
+
+/**
+ * Garbage collection of the value log as a pass of its own. Every SST that
+ * points into a value log file of which at least value_log_gc_ratio is
+ * garbage is merged on its own into a new SST that takes its place in its
+ * run. The merge moves the values still live in such files into a new value
+ * log file and points to them there, see level. The old files are deleted
+ * once the last SST pointing into them is gone.
+ * Levels are rewritten one at a time and count as busy meanwhile, so
+ * compactions neither take the rewritten SSTs nor add to their level.
+ * Return the number of rewritten SSTs.
+ */
+uint64_t lsm_tree::collect_value_log_garbage() {
+    std::set<uint64_t> gc_files = vlog->get_gc_files();
+    if (gc_files.empty()) {
+        return 0;
+    }
 
-            delete(sst_a);
-            delete(sst_b);
+    std::vector<uint32_t> level_orders;
+    {
+        std::shared_lock<std::shared_mutex> guard(state_mutex);
+        for (const auto& [level_order, ssts] : segments) {
+            level_orders.push_back(level_order);
+        }
+    }
+
+    uint64_t rewritten{0};
+    for (uint32_t level_order : level_orders) {
+        std::unique_lock<std::shared_mutex> guard(state_mutex);
+        compaction_cv.wait(guard, [&] { return background_error or not busy_levels.contains(level_order); });
+        if (background_error) {
+            std::rethrow_exception(background_error);
+        }
 
-            auto successor = std::next(it);
-            if (successor != segments.end() and successor->first == curr_level + 1) {
-                successor->second.push_back(merged);
-            } else {
-                segments.insert(successor, {curr_level + 1, {merged}});
+        std::vector<std::shared_ptr<level>> inputs;
+        for (const auto& [curr_order, ssts] : segments) {
+            for (const auto& sst : ssts) {
+                if (curr_order == level_order and sst->points_into(gc_files)) {
+                    inputs.push_back(sst);
+                }
             }
         }
+        if (inputs.empty()) {
+            continue;
+        }
 
-        if (it->second.empty()) {
-            it = segments.erase(it);
-        } else {
-            ++it;
+        busy_levels.insert(level_order);
+        filter_allocation filters = get_filter_allocation(inputs);
+        std::vector<uint64_t> snapshot_sequences = snapshots->get_sequences();
+        guard.unlock();
+
+        std::vector<std::shared_ptr<level>> outputs;
+        std::exception_ptr error;
+        try {
+            for (const auto& input : inputs) {
+                outputs.push_back(std::make_shared<level>(get_new_segment_path(level_order), std::vector<std::shared_ptr<level>>{input},
+                                                          key_range{}, input->get_run_id(), false, filters, snapshot_sequences,
+                                                          cache.get(), vlog.get()));
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        guard.lock();
+        busy_levels.erase(level_order);
+        if (not error) {
+            for (auto& [curr_order, ssts] : segments) {
+                if (curr_order != level_order) {
+                    continue;
+                }
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    const level::drop_stats& dropped = outputs[i]->get_drop_stats();
+                    compaction_totals.dropped_tombstones += dropped.dropped_tombstones;
+                    compaction_totals.dropped_versions += dropped.dropped_versions;
+                    compaction_totals.reclaimed_bytes += dropped.reclaimed_bytes;
+
+                    auto it = std::find(ssts.begin(), ssts.end(), inputs[i]);
+                    bool is_empty = outputs[i]->get_num_entries() == 0 and outputs[i]->get_range_tombstones().empty();
+                    if (is_empty) {
+                        ssts.erase(it);
+                    } else {
+                        *it = outputs[i];
+                    }
+                }
+            }
+            std::erase_if(segments, [](const auto& curr_segment) { return curr_segment.second.empty(); });
+            install_version();
+            rewritten += inputs.size();
+        }
+        guard.unlock();
+        compaction_cv.notify_all();
+
+        if (error) {
+            std::rethrow_exception(error);
         }
     }
+    return rewritten;
 }
 
-std::optional<std::string> lsm_tree::search_all_segments(const std::string& target) {
-    for (const auto& curr_segment : segments) {
-        //std::cout << "Search on level " << curr_segment.first << std::endl;
-        for (const level* sst : curr_segment.second) {
-            //std::cout << "Search segment " << sst->get_name() << std::endl;
-            std::optional<std::string> val = sst->search(target);
+/**
+ * Merge the inputs of the job into one sorted run on the target level.
+ * A new run that only holds inputs from an upper level is the newest run of
+ * the target level and goes to the back. If the job also merged runs of
+ * the target level, they were its oldest and the result takes their place
+ * at the front, before any runs that arrived meanwhile.
+ * The input files are deleted once the job and the last reader drop them.
+ */
+void lsm_tree::run_compaction(const compaction_job& job, const filter_allocation& filters, const std::vector<uint64_t>& snapshot_sequences) {
+    level::drop_stats dropped;
+    std::vector<std::shared_ptr<level>> merged = run_subcompactions(job, filters, snapshot_sequences, dropped);
+
+    {
+        std::unique_lock<std::shared_mutex> guard(state_mutex);
+        bool merged_target_level{false};
+
+        for (auto& curr_segment : segments) {
+            if (curr_segment.first != job.level_order and curr_segment.first != job.target_level) {
+                continue;
+            }
+            auto& level_segments = curr_segment.second;
+            for (const auto& input : job.inputs) {
+                auto input_it = std::find(level_segments.begin(), level_segments.end(), input);
+                if (input_it != level_segments.end()) {
+                    level_segments.erase(input_it);
+                    merged_target_level |= curr_segment.first == job.target_level;
+                }
+            }
+        }
+
+        auto it = std::find_if(segments.begin(), segments.end(), [&](const auto& curr_segment) {
+            return curr_segment.first >= job.target_level;
+        });
+        if (it == segments.end() or it->first != job.target_level) {
+            it = segments.insert(it, {job.target_level, {}});
+        }
+
+        auto& target_segments = it->second;
+        auto position = merged_target_level ? target_segments.begin() : target_segments.end();
+        target_segments.insert(position, merged.begin(), merged.end());
+
+        std::erase_if(segments, [](const auto& curr_segment) { return curr_segment.second.empty(); });
+        install_version();
+
+        ++compaction_totals.compactions;
+        compaction_totals.bottommost_compactions += job.bottommost;
+        compaction_totals.dropped_tombstones += dropped.dropped_tombstones;
+        compaction_totals.dropped_versions += dropped.dropped_versions;
+        compaction_totals.reclaimed_bytes += dropped.reclaimed_bytes;
+    }
+}
+
+/**
+ * Split the key space of the inputs into disjoint ranges, one per
+ * SUBCOMPACTION_SIZE input bytes, and merge every range into a separate SST.
+ * The first range is merged by the calling thread, the others on the
+ * subcompaction pool. All SSTs get consecutive ids and share the id of the
+ * first one as their run id. Ranges without any keys are dropped, after
+ * what all ranges dropped is summed up in @param dropped.
+ * If a range fails, the first error is thrown once all ranges are done, and
+ * the SSTs of the other ranges are deleted with their objects.
+ */
+std::vector<std::shared_ptr<level>> lsm_tree::run_subcompactions(const compaction_job& job, const filter_allocation& filters,
+                                                                 const std::vector<uint64_t>& snapshot_sequences,
+                                                                 level::drop_stats& dropped) {
+    uint64_t input_bytes{0};
+    for (const auto& input : job.inputs) {
+        input_bytes += input->get_file_size();
+    }
+    size_t num_ranges = std::clamp<uint64_t>(input_bytes / SUBCOMPACTION_SIZE, 1, std::max(options.max_subcompactions, 1U));
+    std::vector<std::string> boundaries = level::split_key_range(job.inputs, num_ranges);
+
+    std::vector<key_range> ranges(boundaries.size() + 1);
+    for (size_t i = 0; i < boundaries.size(); ++i) {
+        ranges[i].upper = boundaries[i];
+        ranges[i + 1].lower = boundaries[i];
+    }
+
+    uint64_t first_id = segment_i.fetch_add(ranges.size());
+    std::vector<std::shared_ptr<level>> outputs(ranges.size());
+    auto merge_range = [&](size_t i) {
+        outputs[i] = std::make_shared<level>(get_segment_path(first_id + i, job.target_level), job.inputs, ranges[i],
+                                             first_id, job.bottommost, filters, snapshot_sequences, cache.get(), vlog.get());
+    };
+
+    std::vector<std::future<void>> merges;
+    for (size_t i = 1; i < ranges.size(); ++i) {
+        merges.push_back(subcompaction_pool->submit([&merge_range, i] { merge_range(i); }));
+    }
+
+    std::exception_ptr error;
+    try {
+        merge_range(0);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // The merges write into outputs, so all of them finish before throwing.
+    for (auto& merge : merges) {
+        try {
+            merge.get();
+        } catch (...) {
+            if (not error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    for (const auto& output : outputs) {
+        dropped.dropped_tombstones += output->get_drop_stats().dropped_tombstones;
+        dropped.dropped_versions += output->get_drop_stats().dropped_versions;
+        dropped.reclaimed_bytes += output->get_drop_stats().reclaimed_bytes;
+    }
+    std::erase_if(outputs, [](const auto& output) {
+        return output->get_num_entries() == 0 and output->get_range_tombstones().empty();
+    });
+    return outputs;
+}
+
+/**
+ * Return the newest version of @param target visible at @param sequence in
+ * the SSTs and raise @param covering to the newest range tombstone covering
+ * the target on the way. An SST whose versions are all older than that
+ * tombstone is skipped without probing it.
+ */
+std::optional<key_version> lsm_tree::search_all_segments(const segment_list& ssts, const std::string& target, uint64_t sequence,
+                                                         uint64_t& covering) {
+    for (const auto& curr_segment : ssts) {
+        // Newer SSTs are appended to the back of their level and dominate older ones.
+        for (auto sst = curr_segment.second.rbegin(); sst != curr_segment.second.rend(); ++sst) {
+            covering = std::max(covering, (*sst)->get_range_tombstones().max_covering(target, sequence));
+            if ((*sst)->get_max_sequence() < covering) {
+                continue;
+            }
+            std::optional<key_version> val = (*sst)->search(target, sequence);
             if (val.has_value()) {
                 return val;
             }
@@ -141,32 +890,161 @@ std::optional<std::string> lsm_tree::search_all_segments(const std::string& targ
 }
 
 /**
- * Restore the memtable and the SSTs after restarting the db.
+ * Search the sorted @param targets at the @param pending positions in all
+ * SSTs, newest first, and store what is found in @param values. Every SST
+ * gets the keys still pending as one batch, and a key leaves the batch at
+ * the first SST that holds a version visible at @param sequence. Like
+ * search_all_segments(), @param covering tracks the newest range tombstone
+ * of every target, and SSTs older than it are not probed for the target.
+ */
+void lsm_tree::multi_search_all_segments(const segment_list& ssts, const std::vector<std::string_view>& targets,
+                                         std::vector<size_t>& pending, std::vector<std::optional<key_version>>& values,
+                                         std::vector<uint64_t>& covering, uint64_t sequence) {
+    std::vector<uint64_t> hashes(targets.size());
+    for (size_t i : pending) {
+        hashes[i] = bloom_filter::hash(targets[i]);
+    }
+
+    std::vector<std::string_view> batch;
+    std::vector<uint64_t> batch_hashes;
+    std::vector<size_t> batch_targets;
+    for (const auto& curr_segment : ssts) {
+        for (auto sst = curr_segment.second.rbegin(); sst != curr_segment.second.rend(); ++sst) {
+            if (pending.empty()) {
+                return;
+            }
+
+            const range_tombstone_list& sst_tombstones = (*sst)->get_range_tombstones();
+            batch.clear();
+            batch_hashes.clear();
+            batch_targets.clear();
+            for (size_t i : pending) {
+                covering[i] = std::max(covering[i], sst_tombstones.max_covering(targets[i], sequence));
+                if ((*sst)->get_max_sequence() >= covering[i]) {
+                    batch.push_back(targets[i]);
+                    batch_hashes.push_back(hashes[i]);
+                    batch_targets.push_back(i);
+                }
+            }
+            if (batch.empty()) {
+                continue;
+            }
+
+            std::vector<std::optional<key_version>> found = (*sst)->multi_search(batch, batch_hashes, sequence);
+            for (size_t j = 0; j < batch.size(); ++j) {
+                values[batch_targets[j]] = std::move(found[j]);
+            }
+            std::erase_if(pending, [&values](size_t i) { return values[i].has_value(); });
+        }
+    }
+}
+
+/**
+ * Restore the SSTs and the memtable after restarting the db.
  */
 void lsm_tree::restore_db() {
-    restore_memtable();
     restore_segments();
+    restore_memtable();
 }
 
 /**
- * Restore a memtable from its WAL. 
+ * Restore the memtable from the WAL files. Every WAL belongs to one memtable,
+ * older WALs are left over from memtables whose flush did not finish. They
+ * are replayed and flushed right away in order, the newest WAL becomes the
+ * log of the active memtable again.
  */
 void lsm_tree::restore_memtable() {
-    wal.repopulate_memtable(memtable);
+    std::filesystem::create_directories(wal_dir);
+
+    std::vector<uint64_t> wal_numbers;
+    for (const auto& file : std::filesystem::directory_iterator(wal_dir)) {
+        if (file.path().extension() == ".log") {
+            wal_numbers.push_back(std::stoull(file.path().stem().string()));
+        }
+    }
+    std::sort(wal_numbers.begin(), wal_numbers.end());
+
+    for (size_t i = 0; i + 1 < wal_numbers.size(); ++i) {
+        write_ahead_log old_wal(get_wal_path(wal_numbers[i]));
+        skiplist_memtable table;
+        next_sequence = std::max(next_sequence, old_wal.repopulate_memtable(table) + 1);
+        if (table.get_num_entries() > 0 or table.get_num_range_tombstones() > 0) {
+            flush_memtable_to_disk(table);
+        }
+        old_wal.remove();
+    }
+
+    if (not wal_numbers.empty()) {
+        wal_i = wal_numbers.back();
+    }
+    wal = open_wal(wal_i++);
+    next_sequence = std::max(next_sequence, wal->repopulate_memtable(*memtable) + 1);
+    last_sequence = next_sequence - 1;
 }
 
 /**
- * Restore all segment files from disk.
+ * Restore all segment files from disk. New writes continue after the
+ * largest sequence number stored in them. Value log files no SST points
+ * into are deleted.
  */
 void lsm_tree::restore_segments() {
-    auto last_segment_i_and_segments = level::collect_levels(SEGMENT_BASE, MEMTABLE_SIZE);
+    std::filesystem::create_directories(segment_dir);
+    vlog->restore();
+    auto last_segment_i_and_segments = level::collect_levels(segment_dir, options.bloom_bits_per_key, cache.get(), *vlog);
     segment_i = last_segment_i_and_segments.first + 1;
     segments = last_segment_i_and_segments.second;
+    vlog->release_restored();
+
+    for (const auto& curr_segment : segments) {
+        for (const auto& sst : curr_segment.second) {
+            next_sequence = std::max(next_sequence, sst->get_max_sequence() + 1);
+        }
+    }
 }
 
 /*
  * Create a new unique segment path.
  */
 std::string lsm_tree::get_new_segment_path(uint16_t level_order) {
-    return SEGMENT_BASE + level::create_filename_based_on_level(segment_i++, level_order) + ".sst";
+    return get_segment_path(segment_i++, level_order);
+}
+
+std::string lsm_tree::get_segment_path(uint64_t id, uint16_t level_order) const {
+    return segment_dir + level::create_filename_based_on_level(id, level_order) + ".sst";
+}
+
+std::string lsm_tree::get_wal_path(uint64_t wal_number) const {
+    return wal_dir + std::to_string(wal_number) + ".log";
+}
+
+std::unique_ptr<write_ahead_log> lsm_tree::open_wal(uint64_t wal_number) const {
+    return std::make_unique<write_ahead_log>(get_wal_path(wal_number), options.wal_sync_mode, options.wal_sync_interval_ms);
+}
+
+/**
+ * Return how bloom filter bits are handed out to new SSTs. With a memory
+ * budget the allocation is based on the current number of entries per level,
+ * so every flush and compaction rebuilds its filter with the latest split.
+ * The @param replaced SSTs, the inputs of a compaction, are left out since
+ * its outputs take their entries over.
+ * The caller has to hold state_mutex.
+ */
+filter_allocation lsm_tree::get_filter_allocation(const std::vector<std::shared_ptr<level>>& replaced) const {
+    if (options.bloom_memory_budget == 0) {
+        return filter_allocation(options.bloom_bits_per_key);
+    }
+
+    std::vector<uint64_t> entries_per_level;
+    for (const auto& curr_segment : segments) {
+        if (entries_per_level.size() <= curr_segment.first) {
+            entries_per_level.resize(curr_segment.first + 1, 0);
+        }
+        for (const auto& sst : curr_segment.second) {
+            if (std::find(replaced.begin(), replaced.end(), sst) == replaced.end()) {
+                entries_per_level[curr_segment.first] += sst->get_num_entries();
+            }
+        }
+    }
+
+    return {entries_per_level, options.bloom_memory_budget * 8, options.bloom_skip_last_level};
 }
@@ -3,42 +3,202 @@
 
 #include "../utils/types.hpp"
 #include "../bloom_filter/bloom.hpp"
-#include "../red_black_tree/red_black.hpp"
+#include "../memtable/skiplist_memtable.hpp"
 #include "../wal/wal.hpp"
 #include "level/level.hpp"
+#include "options.hpp"
+#include "write_batch.hpp"
+#include "lsm_iterator.hpp"
+#include "snapshot.hpp"
+#include "tree_version.hpp"
+#include "../cache/block_cache.hpp"
+#include "../compaction/compaction_policy.hpp"
+#include "../vlog/value_log.hpp"
+#include "../utils/thread_pool.hpp"
 #include <string>
 #include <list>
 #include <vector>
+#include <span>
 #include <optional>
-
-#define WAL_PATH "../src/.internal_storage/wal.log"
-#define SEGMENT_BASE "../src/.internal_storage/segments/"
-
+#include <memory>
+#include <atomic>
+#include <set>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <thread>
+
+/**
+ * Writes go to the WAL and the active memtable. Once the active memtable is
+ * full it is swapped into the immutable slot together with its WAL, and a
+ * fresh memtable with a new WAL takes over immediately. A background thread
+ * writes the immutable memtable to a new SST and retires its WAL.
+ * A pool of compaction threads merges SSTs down the levels. The compaction
+ * policy scores every level against its target and the most urgent job on
+ * levels that no other thread works on runs next, so jobs on different
+ * levels run concurrently. Large jobs are split by key range and the ranges
+ * are merged in parallel on a shared pool of subcompaction threads.
+ * Writers queue up under write_mutex. The writer at the front becomes the
+ * leader and appends the entries of all queued writers to the WAL as a
+ * single record with a single sync. Then every writer of the group inserts
+ * its own entries into the memtable in parallel, and the last one to finish
+ * releases the group in queue order.
+ * Every write gets the next sequence number, which the leader hands out.
+ * The last writer of a group publishes them in last_sequence once the whole
+ * group is in the memtable. Reads
+ * only see versions up to the sequence number they started at, which makes
+ * groups visible atomically.
+ * The memtable pointers and the segments are guarded by state_mutex, which
+ * writers and background threads take to change them. Every change
+ * installs a new immutable tree_version, and reads only pin the current
+ * version, so they never wait for a flush or a compaction to publish.
+ * Reads pin the version before they take the last sequence number, so the
+ * version holds every write they may see.
+ * A flush that fails keeps its memtable and its WAL, a compaction that fails
+ * keeps its inputs. The error is kept as the background error and every
+ * later write fails with it, so no write is acknowledged that might never
+ * reach an SST. A WAL that fails to write or sync is a background error as
+ * well, including a background sync of a log that is no longer active.
+ * With a value log threshold, large values only stay in the WAL and the
+ * memtable. Flushes move them to the value log and compactions copy their
+ * pointers, see value_log. collect_value_log_garbage() rewrites the SSTs
+ * pointing into mostly stale value log files on demand.
+ */
 class lsm_tree {
 
     public:
-        lsm_tree();
+        explicit lsm_tree(const lsm_options& options = lsm_options());
 
         ~lsm_tree();
         
         void put(const std::string& key, const std::string& value);
 
-        std::string get(const std::string& key);
+        std::string get(const std::string& key, const snapshot* snap = nullptr);
+
+        std::vector<std::string> multi_get(std::span<const std::string> keys, const snapshot* snap = nullptr);
 
         void remove(const std::string& key);
 
+        void delete_range(const std::string& begin, const std::string& end);
+
+        void write(const write_batch& batch);
+
+        lsm_iterator new_iterator(lsm_iterator::direction dir = lsm_iterator::FORWARD, const snapshot* snap = nullptr);
+
+        std::shared_ptr<const snapshot> get_snapshot();
+
         void drop_table();
 
-    private:
-        static const uint64_t MEMTABLE_SIZE{67108864}; // 64 MBs
+        void close();
 
+        uint64_t collect_value_log_garbage();
 
-        red_black_tree memtable;
-        std::list<std::pair<uint32_t, std::vector<level*>>> segments;
-        write_ahead_log wal;
-        uint16_t segment_i{0};
+        block_cache::stats get_block_cache_stats() const;
 
-        void flush_memtable_to_disk();
+        compaction_stats get_compaction_stats();
+
+    private:
+        static const uint64_t MEMTABLE_SIZE{67108864}; // 64 MBs
+        // Input bytes of a compaction per parallel subcompaction.
+        static const uint64_t SUBCOMPACTION_SIZE{MEMTABLE_SIZE};
+        // A leader stops adding followers to its group at this WAL record size.
+        static const uint64_t MAX_GROUP_SIZE{1024 * 1024};
+
+        struct write_group;
+
+        struct writer {
+            explicit writer(const std::vector<kv_pair>* entries): entries(entries) {}
+
+            // nullptr for exclusive operations like drop_table.
+            const std::vector<kv_pair>* entries;
+            // Sequence number of the first entry, set by the leader.
+            uint64_t sequence{0};
+            // Set by the leader once the entries are in the WAL, the writer
+            // then inserts them into the memtable.
+            write_group* group{nullptr};
+            bool done{false};
+            std::exception_ptr error;
+            std::condition_variable cv;
+        };
+
+        struct write_group {
+            std::vector<writer*> members;
+            skiplist_memtable* table{nullptr};
+            uint64_t last_sequence{0};
+            // Members that still insert, guarded by write_mutex.
+            size_t pending{0};
+            std::exception_ptr error;
+        };
+
+
+        lsm_options options;
+        std::string wal_dir;
+        std::string segment_dir;
+        std::unique_ptr<block_cache> cache;
+        std::unique_ptr<value_log> vlog;
+        std::unique_ptr<compaction_policy> compaction;
+
+        std::shared_ptr<skiplist_memtable> memtable;
+        std::shared_ptr<skiplist_memtable> immutable_memtable;
+        segment_list segments;
+        std::unique_ptr<write_ahead_log> wal;
+        std::unique_ptr<write_ahead_log> immutable_wal;
+        std::atomic<uint64_t> segment_i{0};
+        uint64_t wal_i{0};
+
+        // Sequence number of the next write, only used by the leader.
+        uint64_t next_sequence{1};
+        std::atomic<uint64_t> last_sequence{0};
+        std::shared_ptr<snapshot_list> snapshots;
+        // Only guards swapping and copying the pointer, never held across a read.
+        std::mutex version_mutex;
+        std::shared_ptr<const tree_version> current_version;
+
+        std::mutex write_mutex;
+        std::deque<writer*> writers;
+        std::shared_mutex state_mutex;
+        std::condition_variable_any flush_cv;
+        std::condition_variable_any compaction_cv;
+        std::set<uint32_t> busy_levels;
+        compaction_stats compaction_totals;
+        // First error of a background thread, fails all later writes.
+        std::exception_ptr background_error;
+        bool stop_background{false};
+        // Set by close(), the destructor then leaves the files on disk.
+        bool closed{false};
+        std::thread background_thread;
+        std::vector<std::thread> compaction_threads;
+        // Runs all but the first key range of a split compaction, nullptr
+        // without subcompactions.
+        std::unique_ptr<thread_pool> subcompaction_pool;
+
+        void commit(const std::vector<kv_pair>& entries);
+
+        void await_turn(writer& w, std::unique_lock<std::mutex>& lock);
+
+        void finish_insert(write_group& group, std::exception_ptr error);
+
+        void finish_turn(const std::vector<writer*>& group, std::exception_ptr error);
+
+        void switch_memtable();
+
+        void install_version();
+
+        std::shared_ptr<const tree_version> get_current_version();
+
+        void stop_background_threads();
+
+        void record_background_error(std::exception_ptr error);
+
+        void check_background_error();
+
+        void background_flush();
+
+        void wait_for_flush();
+
+        void flush_memtable_to_disk(const skiplist_memtable& table);
 
         void restore_db();
 
@@ -46,11 +206,30 @@ class lsm_tree {
 
         void restore_segments();
 
-        void compact();
+        void background_compaction();
+
+        void run_compaction(const compaction_job& job, const filter_allocation& filters, const std::vector<uint64_t>& snapshot_sequences);
+
+        std::vector<std::shared_ptr<level>> run_subcompactions(const compaction_job& job, const filter_allocation& filters,
+                                                               const std::vector<uint64_t>& snapshot_sequences,
+                                                               level::drop_stats& dropped);
+
+        static std::optional<key_version> search_all_segments(const segment_list& ssts, const std::string& target, uint64_t sequence,
+                                                              uint64_t& covering);
 
-        std::optional<std::string> search_all_segments(const std::string& target);
+        static void multi_search_all_segments(const segment_list& ssts, const std::vector<std::string_view>& targets,
+                                              std::vector<size_t>& pending, std::vector<std::optional<key_version>>& values,
+                                              std::vector<uint64_t>& covering, uint64_t sequence);
 
         std::string get_new_segment_path(uint16_t level_order);
+
+        std::string get_segment_path(uint64_t id, uint16_t level_order) const;
+
+        std::string get_wal_path(uint64_t wal_number) const;
+
+        std::unique_ptr<write_ahead_log> open_wal(uint64_t wal_number) const;
+
+        filter_allocation get_filter_allocation(const std::vector<std::shared_ptr<level>>& replaced = {}) const;
 };
 
 #endif // LSM_TREE_H
\ No newline at end of file
@@ -0,0 +1,85 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include "../cache/block_cache.hpp"
+#include "../compaction/compaction_policy.hpp"
+#include "../wal/wal.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Tuning knobs of the lsm_tree, fixed when the database is opened.
+ */
+struct lsm_options {
+    // Directory holding the WAL, SST and value log files of the database.
+    std::string directory{"../src/.internal_storage/"};
+    // CPUs the background flush and compaction threads may run on, empty
+    // lets the scheduler place them anywhere.
+    std::vector<uint32_t> cpu_affinity;
+
+    // Bits of bloom filter memory per key of an SST.
+    double bloom_bits_per_key{10};
+    // Total bloom filter memory in bytes spread across the levels to
+    // minimize wasted SST probes, 0 uses bloom_bits_per_key for every SST.
+    // Every new SST sizes its filter by the split of the moment, filters of
+    // existing SSTs keep their size until the SST is rewritten, so the total
+    // can exceed the budget while the tree grows.
+    uint64_t bloom_memory_budget{0};
+    // Give the deepest level no filter when splitting the budget.
+    bool bloom_skip_last_level{false};
+
+    // Capacity of the block cache in bytes, 0 disables the cache.
+    uint64_t block_cache_size{32 * 1024 * 1024};
+    block_cache::eviction_policy block_cache_policy{block_cache::LRU};
+    // The cache is split into 2^block_cache_shard_bits shards.
+    uint32_t block_cache_shard_bits{4};
+    // Share of the cache reserved for HIGH priority (index) blocks. Only the
+    // LRU policy reserves it, CLOCK merely starts HIGH blocks with a higher
+    // reference count.
+    double block_cache_high_pri_ratio{0.1};
+
+    // When writes are synced to disk, see write_ahead_log::sync_mode.
+    write_ahead_log::sync_mode wal_sync_mode{write_ahead_log::NONE};
+    // Sync period of the INTERVAL sync mode.
+    uint64_t wal_sync_interval_ms{1000};
+
+    // Number of background threads running compactions on disjoint levels.
+    uint32_t compaction_threads{2};
+    // Large compactions are split into up to this many key ranges that are
+    // merged in parallel into separate SSTs.
+    uint32_t max_subcompactions{4};
+    // How SSTs are merged down the levels.
+    compaction_policy::style compaction_style{compaction_policy::TIERED};
+    // Size ratio T between levels: runs per level when tiered, growth of
+    // the level capacity when leveled.
+    uint32_t compaction_size_ratio{2};
+
+    // Values of at least this many bytes are moved out of the SSTs into the
+    // value log by flushes and compactions, 0 keeps all values in the SSTs.
+    uint64_t value_log_threshold{0};
+    // Compactions rewrite the values left in a value log file once at least
+    // this share of the file is garbage.
+    double value_log_gc_ratio{0.5};
+};
+
+/**
+ * Tuning knobs of the sharded_lsm_tree. Every shard is an lsm_tree opened
+ * with the shard options in its own subdirectory of shard.directory, so
+ * cache sizes, bloom budgets and compaction threads apply per shard.
+ */
+struct sharded_options {
+    lsm_options shard;
+    // Fixed when the database is created, a database has to be reopened
+    // with the same number of shards.
+    uint32_t num_shards{8};
+    // Threads of the pool that fans batched reads and writes out to the
+    // shards.
+    uint32_t pool_threads{4};
+    // Pin the background threads of shard i to the i-th equal share of the
+    // CPUs in the process affinity mask, at least one, and pool thread i to
+    // the i-th CPU of the mask modulo the number of CPUs in it.
+    bool pin_to_cores{false};
+};
+
+#endif // OPTIONS_H
@@ -0,0 +1,296 @@
+#include "sharded_lsm_tree.hpp"
+#include "../utils/crc32c.hpp"
+#include <algorithm>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <numeric>
+#include <sched.h>
+#include <stdexcept>
+#include <thread>
+
+namespace {
+
+    /**
+     * The CPUs the process may run on, which can be fewer than the CPUs of
+     * the machine and need not start at 0, e.g. under taskset or in a
+     * container.
+     */
+    std::vector<uint32_t> allowed_cpus() {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (sched_getaffinity(0, sizeof(set), &set) != 0) {
+            throw std::runtime_error("Can not get the CPU affinity of the process");
+        }
+
+        std::vector<uint32_t> cpus;
+        for (uint32_t cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &set)) {
+                cpus.push_back(cpu);
+            }
+        }
+        return cpus;
+    }
+
+    /**
+     * An equal share of @param cpus for @param shard, at least one CPU, so
+     * the compaction threads of a shard still run in parallel. Shards only
+     * share CPUs if there are fewer CPUs than shards.
+     */
+    std::vector<uint32_t> shard_cpus(const std::vector<uint32_t>& cpus, size_t shard, size_t num_shards) {
+        size_t share = std::max<size_t>(cpus.size() / num_shards, 1);
+        size_t first = shard * share % cpus.size();
+        return {cpus.begin() + first, cpus.begin() + std::min(first + share, cpus.size())};
+    }
+
+} // namespace
+
+/**
+ * Open all shards in parallel on the pool. With pin_to_cores the
+ * background threads of shard i run on the i-th equal share of the CPUs the
+ * process may use, and pool thread i runs on the i-th CPU modulo their
+ * number.
+ * If a shard fails to open, the shards opened already are closed without
+ * deleting their data.
+ */
+sharded_lsm_tree::sharded_lsm_tree(const sharded_options& options)
+        : pool(options.pool_threads, options.pin_to_cores ? allowed_cpus() : std::vector<uint32_t>()),
+          shards(std::max(options.num_shards, 1U)) {
+    check_shard_count(options.shard.directory, shards.size());
+
+    std::vector<uint32_t> cpus = options.pin_to_cores ? allowed_cpus() : std::vector<uint32_t>();
+    std::vector<size_t> shard_ids(shards.size());
+    std::iota(shard_ids.begin(), shard_ids.end(), 0);
+    try {
+        run_on_shards(shard_ids, [&](size_t shard) {
+            lsm_options shard_options = options.shard;
+            shard_options.directory = get_shard_directory(options.shard.directory, shard);
+            if (options.pin_to_cores) {
+                shard_options.cpu_affinity = shard_cpus(cpus, shard, shards.size());
+            }
+            shards[shard] = std::make_unique<lsm_tree>(shard_options);
+        });
+    } catch (...) {
+        for (auto& tree : shards) {
+            if (tree != nullptr) {
+                tree->close();
+            }
+        }
+        throw;
+    }
+}
+
+void sharded_lsm_tree::put(const std::string& key, const std::string& value) {
+    shards[shard_of(key)]->put(key, value);
+}
+
+std::string sharded_lsm_tree::get(const std::string& key) {
+    return shards[shard_of(key)]->get(key);
+}
+
+/**
+ * Get the values of a batch of keys, in the order of @param keys. Every
+ * shard looks up its part of the batch with lsm_tree::multi_get, and the
+ * shards are searched in parallel.
+ */
+std::vector<std::string> sharded_lsm_tree::multi_get(std::span<const std::string> keys) {
+    std::vector<std::vector<size_t>> positions(shards.size());
+    for (size_t pos = 0; pos < keys.size(); ++pos) {
+        positions[shard_of(keys[pos])].push_back(pos);
+    }
+
+    std::vector<size_t> shard_ids;
+    for (size_t shard = 0; shard < shards.size(); ++shard) {
+        if (not positions[shard].empty()) {
+            shard_ids.push_back(shard);
+        }
+    }
+
+    std::vector<std::string> result(keys.size());
+    run_on_shards(shard_ids, [&](size_t shard) {
+        std::vector<std::string> shard_keys;
+        shard_keys.reserve(positions[shard].size());
+        for (size_t pos : positions[shard]) {
+            shard_keys.push_back(keys[pos]);
+        }
+
+        std::vector<std::string> values = shards[shard]->multi_get(shard_keys);
+        for (size_t i = 0; i < values.size(); ++i) {
+            result[positions[shard][i]] = std::move(values[i]);
+        }
+    });
+    return result;
+}
+
+void sharded_lsm_tree::remove(const std::string& key) {
+    shards[shard_of(key)]->remove(key);
+}
+
+/**
+ * Hashing scatters a key range over all shards, so every shard gets the
+ * range tombstone. The shards apply it in parallel.
+ */
+void sharded_lsm_tree::delete_range(const std::string& begin, const std::string& end) {
+    if (begin >= end) {
+        return;
+    }
+
+    std::vector<size_t> shard_ids(shards.size());
+    std::iota(shard_ids.begin(), shard_ids.end(), 0);
+    run_on_shards(shard_ids, [&](size_t shard) {
+        shards[shard]->delete_range(begin, end);
+    });
+}
+
+/**
+ * Split @param batch by shard and commit the parts in parallel. Every part
+ * is atomic within its shard, updates of the same key keep their order.
+ * Range deletes go to every shard, see delete_range().
+ */
+void sharded_lsm_tree::write(const write_batch& batch) {
+    std::vector<write_batch> shard_batches(shards.size());
+    for (const kv_pair& entry : batch.get_entries()) {
+        switch (entry.type) {
+            case kv_pair::PUT:
+                shard_batches[shard_of(entry.key)].put(entry.key, entry.val);
+                break;
+            case kv_pair::DELETE:
+                shard_batches[shard_of(entry.key)].remove(entry.key);
+                break;
+            case kv_pair::RANGE_DELETE:
+                for (write_batch& shard_batch : shard_batches) {
+                    shard_batch.delete_range(entry.key, entry.val);
+                }
+                break;
+            case kv_pair::VALUE_POINTER:
+                // Only SSTs hold value pointers, never a write batch.
+                break;
+        }
+    }
+
+    std::vector<size_t> shard_ids;
+    for (size_t shard = 0; shard < shards.size(); ++shard) {
+        if (shard_batches[shard].count() > 0) {
+            shard_ids.push_back(shard);
+        }
+    }
+
+    run_on_shards(shard_ids, [&](size_t shard) {
+        shards[shard]->write(shard_batches[shard]);
+    });
+}
+
+void sharded_lsm_tree::drop_table() {
+    std::vector<size_t> shard_ids(shards.size());
+    std::iota(shard_ids.begin(), shard_ids.end(), 0);
+    run_on_shards(shard_ids, [&](size_t shard) {
+        shards[shard]->drop_table();
+    });
+}
+
+size_t sharded_lsm_tree::get_num_shards() const {
+    return shards.size();
+}
+
+/**
+ * Sum of the block cache stats of all shards.
+ */
+block_cache::stats sharded_lsm_tree::get_block_cache_stats() const {
+    block_cache::stats total;
+    for (const auto& shard : shards) {
+        block_cache::stats curr = shard->get_block_cache_stats();
+        total.hits += curr.hits;
+        total.misses += curr.misses;
+        total.inserts += curr.inserts;
+        total.evictions += curr.evictions;
+        total.usage += curr.usage;
+        total.capacity += curr.capacity;
+    }
+    return total;
+}
+
+/**
+ * Sum of the compaction stats of all shards.
+ */
+compaction_stats sharded_lsm_tree::get_compaction_stats() const {
+    compaction_stats total;
+    for (const auto& shard : shards) {
+        compaction_stats curr = shard->get_compaction_stats();
+        total.compactions += curr.compactions;
+        total.bottommost_compactions += curr.bottommost_compactions;
+        total.dropped_tombstones += curr.dropped_tombstones;
+        total.dropped_versions += curr.dropped_versions;
+        total.reclaimed_bytes += curr.reclaimed_bytes;
+    }
+    return total;
+}
+
+/**
+ * Keys are spread by their CRC32C, which is independent of the hash the
+ * bloom filters of the shards are built on. The 32 bit checksum is mapped
+ * to a shard by multiply-shift.
+ */
+size_t sharded_lsm_tree::shard_of(std::string_view key) const {
+    uint32_t hash = crc32c::value(key.data(), key.size());
+    return ((uint64_t) hash * shards.size()) >> 32;
+}
+
+/**
+ * Run @param task for every shard in @param shard_ids, the first one on
+ * the calling thread and the others on the pool. Waits for all of them,
+ * even if one fails, and rethrows the first error.
+ */
+void sharded_lsm_tree::run_on_shards(const std::vector<size_t>& shard_ids, const std::function<void(size_t)>& task) {
+    std::vector<std::future<void>> pending;
+    for (size_t i = 1; i < shard_ids.size(); ++i) {
+        pending.push_back(pool.submit([&task, shard = shard_ids[i]] { task(shard); }));
+    }
+
+    std::exception_ptr error;
+    try {
+        if (not shard_ids.empty()) {
+            task(shard_ids.front());
+        }
+    } catch (...) {
+        error = std::current_exception();
+    }
+
+    for (auto& result : pending) {
+        try {
+            result.get();
+        } catch (...) {
+            if (not error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+std::string sharded_lsm_tree::get_shard_directory(const std::string& directory, uint32_t shard) {
+    return (std::filesystem::path(directory) / ("shard_" + std::to_string(shard)) / "").string();
+}
+
+/**
+ * Keys are routed by the number of shards, so an existing database can
+ * only be opened with the number of shards it was created with.
+ */
+void sharded_lsm_tree::check_shard_count(const std::string& directory, uint32_t num_shards) {
+    if (not std::filesystem::exists(directory)) {
+        return;
+    }
+
+    uint32_t existing{0};
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.is_directory() and entry.path().filename().string().starts_with("shard_")) {
+            ++existing;
+        }
+    }
+
+    if (existing > 0 and existing != num_shards) {
+        throw std::runtime_error("Database in " + directory + " has " + std::to_string(existing) +
+                                 " shards, but was opened with " + std::to_string(num_shards) + ".");
+    }
+}
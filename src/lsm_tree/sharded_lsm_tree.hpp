@@ -0,0 +1,67 @@
+#ifndef SHARDED_LSM_TREE_H
+#define SHARDED_LSM_TREE_H
+
+#include "lsm_tree.hpp"
+#include "options.hpp"
+#include "write_batch.hpp"
+#include "../cache/block_cache.hpp"
+#include "../utils/thread_pool.hpp"
+#include <functional>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Splits the key space by hash into independent lsm_tree shards, each
+ * with its own directory, WAL, memtable, segments and compaction threads.
+ * Writers to different shards never share a write queue or a lock, so
+ * throughput grows with the number of shards instead of being bound by the
+ * single leader of one tree.
+ * Single key operations go straight to the shard of the key on the calling
+ * thread. Batched reads and writes are split by shard, and the parts are
+ * run in parallel on a pool shared by all shards.
+ * Every shard is consistent on its own: a write batch is atomic within
+ * each shard it touches, but not across shards.
+ */
+class sharded_lsm_tree {
+
+    public:
+        explicit sharded_lsm_tree(const sharded_options& options = sharded_options());
+
+        void put(const std::string& key, const std::string& value);
+
+        std::string get(const std::string& key);
+
+        std::vector<std::string> multi_get(std::span<const std::string> keys);
+
+        void remove(const std::string& key);
+
+        void delete_range(const std::string& begin, const std::string& end);
+
+        void write(const write_batch& batch);
+
+        void drop_table();
+
+        size_t get_num_shards() const;
+
+        block_cache::stats get_block_cache_stats() const;
+
+        compaction_stats get_compaction_stats() const;
+
+    private:
+        // Declared first, so the pool can open the shards and outlives them.
+        thread_pool pool;
+        std::vector<std::unique_ptr<lsm_tree>> shards;
+
+        size_t shard_of(std::string_view key) const;
+
+        void run_on_shards(const std::vector<size_t>& shard_ids, const std::function<void(size_t)>& task);
+
+        static std::string get_shard_directory(const std::string& directory, uint32_t shard);
+
+        static void check_shard_count(const std::string& directory, uint32_t num_shards);
+};
+
+#endif // SHARDED_LSM_TREE_H
@@ -0,0 +1,53 @@
+#include "snapshot.hpp"
+#include <algorithm>
+
+snapshot::snapshot(std::shared_ptr<snapshot_list> list, uint64_t sequence)
+        : list(std::move(list)), sequence(sequence) {}
+
+snapshot::~snapshot() {
+    list->release(sequence);
+}
+
+uint64_t snapshot::get_sequence() const {
+    return sequence;
+}
+
+/**
+ * Register a snapshot at the current @param last_sequence. The sequence
+ * number is read under the lock, so a flush or compaction collecting the
+ * sequences either sees the new snapshot or only merges versions up to its
+ * sequence number, of which the snapshot reads the newest that is kept
+ * anyway.
+ */
+std::shared_ptr<const snapshot> snapshot_list::create(const std::atomic<uint64_t>& last_sequence) {
+    std::lock_guard<std::mutex> guard(mutex);
+    uint64_t sequence = last_sequence.load(std::memory_order_acquire);
+    sequences.insert(sequence);
+    return std::make_shared<const snapshot>(shared_from_this(), sequence);
+}
+
+/**
+ * Return the distinct sequence numbers of the live snapshots in ascending
+ * order.
+ */
+std::vector<uint64_t> snapshot_list::get_sequences() const {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::vector<uint64_t> result;
+    std::unique_copy(sequences.begin(), sequences.end(), std::back_inserter(result));
+    return result;
+}
+
+/**
+ * Return the index of the oldest snapshot in the ascending @param sequences
+ * that sees a version with @param sequence, or sequences.size() if only
+ * reads at the latest state see it. Of the versions of a key with the same
+ * stripe, only the newest is visible to anyone.
+ */
+size_t snapshot_list::stripe(uint64_t sequence, const std::vector<uint64_t>& sequences) {
+    return std::lower_bound(sequences.begin(), sequences.end(), sequence) - sequences.begin();
+}
+
+void snapshot_list::release(uint64_t sequence) {
+    std::lock_guard<std::mutex> guard(mutex);
+    sequences.erase(sequences.find(sequence));
+}
@@ -0,0 +1,58 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+class snapshot_list;
+
+/**
+ * Consistent read view of the db at a sequence number. Reads at a snapshot
+ * see every write up to its sequence number and none after it. While the
+ * snapshot lives, flushes and compactions keep the versions it reads.
+ */
+class snapshot {
+
+    public:
+        snapshot(std::shared_ptr<snapshot_list> list, uint64_t sequence);
+
+        ~snapshot();
+
+        snapshot(const snapshot&) = delete;
+
+        snapshot& operator=(const snapshot&) = delete;
+
+        uint64_t get_sequence() const;
+
+    private:
+        std::shared_ptr<snapshot_list> list;
+        uint64_t sequence;
+};
+
+/**
+ * Sequence numbers of all live snapshots. Shared with the snapshots, so a
+ * snapshot may outlive the db it was taken from.
+ */
+class snapshot_list : public std::enable_shared_from_this<snapshot_list> {
+
+    public:
+        std::shared_ptr<const snapshot> create(const std::atomic<uint64_t>& last_sequence);
+
+        std::vector<uint64_t> get_sequences() const;
+
+        static size_t stripe(uint64_t sequence, const std::vector<uint64_t>& sequences);
+
+    private:
+        friend class snapshot;
+
+        mutable std::mutex mutex;
+        std::multiset<uint64_t> sequences;
+
+        void release(uint64_t sequence);
+};
+
+#endif // SNAPSHOT_H
@@ -0,0 +1,22 @@
+#ifndef TREE_VERSION_H
+#define TREE_VERSION_H
+
+#include "../memtable/skiplist_memtable.hpp"
+#include "level/level.hpp"
+#include <memory>
+
+/**
+ * Immutable view of the memtables and SSTs at one point in time. Every
+ * switch, flush and compaction installs a new version, and reads pin the
+ * current one by taking a reference instead of locking the tree. A version
+ * keeps its memtables and SSTs alive, so replaced SST files are only
+ * removed once the last version holding them is dropped.
+ */
+struct tree_version {
+    std::shared_ptr<skiplist_memtable> memtable;
+    // nullptr unless a flush is pending.
+    std::shared_ptr<skiplist_memtable> immutable_memtable;
+    segment_list segments;
+};
+
+#endif // TREE_VERSION_H
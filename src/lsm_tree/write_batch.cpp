@@ -0,0 +1,45 @@
+#include "write_batch.hpp"
+
+void write_batch::put(const std::string& key, const std::string& value) {
+    entries.push_back({key, value});
+    bytes += key.size() + value.size();
+}
+
+/**
+ * Removing a key writes a DELETE record, like lsm_tree::remove.
+ */
+void write_batch::remove(const std::string& key) {
+    entries.push_back({key, "", kv_pair::DELETE});
+    bytes += key.size();
+}
+
+/**
+ * Delete all keys in [@param begin, @param end), like lsm_tree::delete_range.
+ * Empty ranges are ignored.
+ */
+void write_batch::delete_range(const std::string& begin, const std::string& end) {
+    if (begin < end) {
+        entries.push_back({begin, end, kv_pair::RANGE_DELETE});
+        bytes += begin.size() + end.size();
+    }
+}
+
+void write_batch::clear() {
+    entries.clear();
+    bytes = 0;
+}
+
+size_t write_batch::count() const {
+    return entries.size();
+}
+
+/**
+ * Size of all keys and values in bytes.
+ */
+uint64_t write_batch::byte_size() const {
+    return bytes;
+}
+
+const std::vector<kv_pair>& write_batch::get_entries() const {
+    return entries;
+}
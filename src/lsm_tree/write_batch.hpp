@@ -0,0 +1,37 @@
+#ifndef WRITE_BATCH_H
+#define WRITE_BATCH_H
+
+#include "../utils/types.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * Collects puts, removes and range deletes that are committed atomically by
+ * lsm_tree::write: the whole batch goes into a single WAL record, so after a
+ * crash either all of its updates are recovered or none of them.
+ * Updates of the same key are applied in the order they were added.
+ */
+class write_batch {
+
+    public:
+        void put(const std::string& key, const std::string& value);
+
+        void remove(const std::string& key);
+
+        void delete_range(const std::string& begin, const std::string& end);
+
+        void clear();
+
+        size_t count() const;
+
+        uint64_t byte_size() const;
+
+        const std::vector<kv_pair>& get_entries() const;
+
+    private:
+        std::vector<kv_pair> entries;
+        uint64_t bytes{0};
+};
+
+#endif // WRITE_BATCH_H
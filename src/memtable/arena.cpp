@@ -0,0 +1,54 @@
+#include "arena.hpp"
+
+arena::arena() {
+    current.store(new_chunk(CHUNK_SIZE), std::memory_order_release);
+}
+
+/**
+ * Return @param bytes of uninitialized memory aligned for any object.
+ * Requests larger than a quarter chunk get a dedicated chunk, so a large
+ * value never wastes the rest of the shared chunk.
+ */
+char* arena::allocate(size_t bytes) {
+    bytes = (bytes + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+    if (bytes > CHUNK_SIZE / 4) {
+        std::lock_guard<std::mutex> guard(chunks_mutex);
+        chunk* dedicated = new_chunk(bytes);
+        dedicated->used.store(bytes, std::memory_order_relaxed);
+        return dedicated->data.get();
+    }
+
+    while (true) {
+        chunk* curr = current.load(std::memory_order_acquire);
+        size_t offset = curr->used.fetch_add(bytes, std::memory_order_relaxed);
+        if (offset + bytes <= curr->size) {
+            return curr->data.get() + offset;
+        }
+
+        // The chunk is exhausted, the first thread to get the lock replaces it.
+        std::lock_guard<std::mutex> guard(chunks_mutex);
+        if (current.load(std::memory_order_acquire) == curr) {
+            current.store(new_chunk(CHUNK_SIZE), std::memory_order_release);
+        }
+    }
+}
+
+uint64_t arena::memory_usage() const {
+    return allocated_bytes.load(std::memory_order_relaxed);
+}
+
+/**
+ * Allocate a new chunk. The caller has to hold chunks_mutex, except in the
+ * constructor.
+ */
+arena::chunk* arena::new_chunk(size_t size) {
+    auto c = std::make_unique<chunk>();
+    // operator new[] already returns memory aligned to ALIGNMENT.
+    c->data = std::unique_ptr<char[]>(new char[size]);
+    c->size = size;
+
+    allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+    chunks.push_back(std::move(c));
+    return chunks.back().get();
+}
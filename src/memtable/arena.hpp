@@ -0,0 +1,51 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/**
+ * Bump allocator handing out memory from large chunks.
+ * Allocation is safe from many threads: a thread reserves its bytes in the
+ * current chunk with a single fetch_add and only takes the lock to install
+ * a new chunk once the current one is exhausted.
+ * Memory is never freed individually, all chunks are released together
+ * when the arena is destroyed.
+ */
+class arena {
+
+    public:
+        arena();
+
+        arena(const arena&) = delete;
+
+        arena& operator=(const arena&) = delete;
+
+        char* allocate(size_t bytes);
+
+        uint64_t memory_usage() const;
+
+    private:
+        static const size_t CHUNK_SIZE{4 * 1024 * 1024};
+        static const size_t ALIGNMENT{alignof(std::max_align_t)};
+
+        struct chunk {
+            std::unique_ptr<char[]> data;
+            size_t size;
+            std::atomic<size_t> used{0};
+        };
+
+        std::atomic<chunk*> current{nullptr};
+        std::atomic<uint64_t> allocated_bytes{0};
+
+        std::mutex chunks_mutex;
+        std::vector<std::unique_ptr<chunk>> chunks;
+
+        chunk* new_chunk(size_t size);
+};
+
+#endif // ARENA_H
@@ -0,0 +1,302 @@
+#include "skiplist.hpp"
+#include <cstring>
+#include <new>
+#include <random>
+#include <type_traits>
+
+skiplist::skiplist(arena& mem): mem(mem) {
+    head = new_node("", "", 0, kv_pair::PUT, MAX_HEIGHT);
+}
+
+static_assert(std::is_trivially_destructible_v<std::atomic<void*>>,
+              "skiplist nodes are freed with the arena without running destructors");
+
+/**
+ * Insert the key or add a new version of it.
+ * Find the predecessor and successor of the key on every level, then link
+ * the new node bottom-up with one compare-and-swap per level. If a CAS
+ * fails because another thread linked a node in between, the splice of
+ * that level is searched again starting from the old predecessor.
+ * Return the key and value bytes of the new version, older versions stay in
+ * the arena and keep counting, and set @param inserted if the key did not
+ * exist yet.
+ */
+uint64_t skiplist::insert(std::string_view key, std::string_view value, uint64_t sequence, kv_pair::record_type type, bool& inserted) {
+    node* preds[MAX_HEIGHT];
+    node* succs[MAX_HEIGHT];
+
+    int list_height = max_height.load(std::memory_order_relaxed);
+    for (int i = list_height; i < MAX_HEIGHT; ++i) {
+        preds[i] = head;
+        succs[i] = nullptr;
+    }
+
+    node* before = head;
+    for (int i = list_height - 1; i >= 0; --i) {
+        find_splice_for_level(key, before, i, preds[i], succs[i]);
+        before = preds[i];
+    }
+
+    if (succs[0] != nullptr and succs[0]->key() == key) {
+        inserted = false;
+        add_version(succs[0], value, sequence, type);
+        return key.size() + value.size();
+    }
+
+    int height = random_height();
+    while (height > list_height and not max_height.compare_exchange_weak(list_height, height)) {}
+
+    node* x = new_node(key, value, sequence, type, height);
+    for (int i = 0; i < height; ++i) {
+        while (true) {
+            if (i == 0 and succs[0] != nullptr and succs[0]->key() == key) {
+                // Another thread inserted the same key concurrently, the
+                // unlinked node is reclaimed with the arena.
+                inserted = false;
+                add_version(succs[0], value, sequence, type);
+                return key.size() + value.size();
+            }
+
+            x->next[i].store(succs[i], std::memory_order_relaxed);
+            if (preds[i]->next[i].compare_exchange_strong(succs[i], x, std::memory_order_release)) {
+                break;
+            }
+            find_splice_for_level(key, preds[i], i, preds[i], succs[i]);
+        }
+    }
+
+    inserted = true;
+    return key.size() + value.size();
+}
+
+/**
+ * Return the newest version of the key with a sequence number <= @param
+ * sequence.
+ */
+std::optional<key_version> skiplist::get(std::string_view key, uint64_t sequence) const {
+    node* x = find_greater_or_equal(key);
+    if (x == nullptr or x->key() != key) {
+        return {};
+    }
+
+    const value_record* record = visible_version(x, sequence);
+    if (record == nullptr) {
+        return {};
+    }
+    return key_version{record->type, record->sequence, std::string(record->value())};
+}
+
+skiplist::node* skiplist::new_node(std::string_view key, std::string_view value, uint64_t sequence, kv_pair::record_type type,
+                                   int height) {
+    size_t bytes = sizeof(node) + sizeof(std::atomic<node*>) * (height - 1) + key.size();
+    char* mem_ptr = mem.allocate(bytes);
+
+    node* x = new (mem_ptr) node{{}, (uint32_t) key.size(), height, {}};
+    x->value.store(new_value(value, sequence, type, nullptr), std::memory_order_relaxed);
+    for (int i = 0; i < height; ++i) {
+        new (&x->next[i]) std::atomic<node*>(nullptr);
+    }
+    std::memcpy(reinterpret_cast<char*>(&x->next[height]), key.data(), key.size());
+    return x;
+}
+
+skiplist::value_record* skiplist::new_value(std::string_view value, uint64_t sequence, kv_pair::record_type type, value_record* older) {
+    char* mem_ptr = mem.allocate(sizeof(value_record) + value.size());
+
+    auto* record = new (mem_ptr) value_record{older, sequence, (uint32_t) value.size(), type};
+    std::memcpy(mem_ptr + sizeof(value_record), value.data(), value.size());
+    return record;
+}
+
+/**
+ * Publish a new version for an existing node. The older versions are
+ * chained behind the new one for reads at older sequence numbers.
+ * Writers of one group insert concurrently, so newer versions of the key
+ * may already be linked. The record is linked in behind them with a
+ * compare-and-swap on the pointer that leads to the first older version.
+ */
+void skiplist::add_version(node* x, std::string_view value, uint64_t sequence, kv_pair::record_type type) {
+    value_record* record = new_value(value, sequence, type, nullptr);
+
+    std::atomic<value_record*>* link = &x->value;
+    value_record* curr = link->load(std::memory_order_acquire);
+    while (true) {
+        while (curr != nullptr and curr->sequence > sequence) {
+            link = &curr->older;
+            curr = link->load(std::memory_order_acquire);
+        }
+        record->older.store(curr, std::memory_order_relaxed);
+        if (link->compare_exchange_weak(curr, record, std::memory_order_release, std::memory_order_acquire)) {
+            return;
+        }
+    }
+}
+
+/**
+ * Return the newest version of @param x with a sequence number <= @param
+ * sequence, or nullptr if all versions are newer.
+ */
+const skiplist::value_record* skiplist::visible_version(const node* x, uint64_t sequence) {
+    const value_record* record = x->value.load(std::memory_order_acquire);
+    while (record != nullptr and record->sequence > sequence) {
+        record = record->older.load(std::memory_order_acquire);
+    }
+    return record;
+}
+
+skiplist::node* skiplist::find_greater_or_equal(std::string_view key) const {
+    node* x = head;
+    for (int i = max_height.load(std::memory_order_relaxed) - 1; i >= 0; --i) {
+        node* next = x->next[i].load(std::memory_order_acquire);
+        while (next != nullptr and next->key() < key) {
+            x = next;
+            next = x->next[i].load(std::memory_order_acquire);
+        }
+        if (i == 0) {
+            return next;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * Return the last node with a key < @param key, or nullptr if there is none.
+ * Nodes have no back pointers, so moving backwards searches from the head.
+ */
+skiplist::node* skiplist::find_less_than(std::string_view key) const {
+    node* x = head;
+    for (int i = max_height.load(std::memory_order_relaxed) - 1; i >= 0; --i) {
+        node* next = x->next[i].load(std::memory_order_acquire);
+        while (next != nullptr and next->key() < key) {
+            x = next;
+            next = x->next[i].load(std::memory_order_acquire);
+        }
+    }
+    return x == head ? nullptr : x;
+}
+
+skiplist::node* skiplist::find_last() const {
+    node* x = head;
+    for (int i = max_height.load(std::memory_order_relaxed) - 1; i >= 0; --i) {
+        node* next = x->next[i].load(std::memory_order_acquire);
+        while (next != nullptr) {
+            x = next;
+            next = x->next[i].load(std::memory_order_acquire);
+        }
+    }
+    return x == head ? nullptr : x;
+}
+
+/**
+ * Starting at @param before, find the nodes between which the key belongs on
+ * @param level: pred->key < key <= succ->key.
+ */
+void skiplist::find_splice_for_level(std::string_view key, node* before, int level, node*& pred, node*& succ) const {
+    node* x = before;
+    while (true) {
+        node* next = x->next[level].load(std::memory_order_acquire);
+        if (next == nullptr or next->key() >= key) {
+            pred = x;
+            succ = next;
+            return;
+        }
+        x = next;
+    }
+}
+
+int skiplist::random_height() {
+    thread_local std::minstd_rand rng(std::random_device{}());
+
+    int height{1};
+    while (height < MAX_HEIGHT and rng() % BRANCHING == 0) {
+        ++height;
+    }
+    return height;
+}
+
+skiplist::iterator::iterator(const skiplist* list, uint64_t sequence): list(list), snapshot(sequence) {}
+
+bool skiplist::iterator::valid() const {
+    return curr != nullptr;
+}
+
+void skiplist::iterator::next() {
+    curr = curr->next[0].load(std::memory_order_acquire);
+    skip_invisible_forward();
+}
+
+void skiplist::iterator::prev() {
+    curr = list->find_less_than(curr->key());
+    skip_invisible_backward();
+}
+
+void skiplist::iterator::seek(std::string_view target) {
+    curr = list->find_greater_or_equal(target);
+    skip_invisible_forward();
+}
+
+/**
+ * Position at the last key <= @param target.
+ */
+void skiplist::iterator::seek_for_prev(std::string_view target) {
+    curr = list->find_greater_or_equal(target);
+    if (curr == nullptr or curr->key() != target) {
+        curr = list->find_less_than(target);
+    }
+    skip_invisible_backward();
+}
+
+void skiplist::iterator::seek_to_first() {
+    curr = list->head->next[0].load(std::memory_order_acquire);
+    skip_invisible_forward();
+}
+
+void skiplist::iterator::seek_to_last() {
+    curr = list->find_last();
+    skip_invisible_backward();
+}
+
+std::string_view skiplist::iterator::key() const {
+    return curr->key();
+}
+
+std::string_view skiplist::iterator::value() const {
+    return version->value();
+}
+
+uint64_t skiplist::iterator::sequence() const {
+    return version->sequence;
+}
+
+kv_pair::record_type skiplist::iterator::type() const {
+    return version->type;
+}
+
+/**
+ * Move to the next older version of the current key. Return false and stay
+ * on the oldest version if there is none.
+ */
+bool skiplist::iterator::next_version() {
+    const value_record* older = version->older.load(std::memory_order_acquire);
+    if (older == nullptr) {
+        return false;
+    }
+    version = older;
+    return true;
+}
+
+/**
+ * Keys written after the snapshot of the iterator are skipped, the iterator
+ * rests on the visible version of the first remaining key.
+ */
+void skiplist::iterator::skip_invisible_forward() {
+    while (curr != nullptr and (version = visible_version(curr, snapshot)) == nullptr) {
+        curr = curr->next[0].load(std::memory_order_acquire);
+    }
+}
+
+void skiplist::iterator::skip_invisible_backward() {
+    while (curr != nullptr and (version = visible_version(curr, snapshot)) == nullptr) {
+        curr = list->find_less_than(curr->key());
+    }
+}
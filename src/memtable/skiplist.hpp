@@ -0,0 +1,147 @@
+#ifndef SKIPLIST_H
+#define SKIPLIST_H
+
+#include "arena.hpp"
+#include "../utils/types.hpp"
+#include <atomic>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+/**
+ * Lock-free concurrent skiplist mapping keys to their versions.
+ * Any number of threads can insert and read at the same time: new nodes are
+ * linked level by level with compare-and-swap, and a new version of a key
+ * is pushed onto the front of its version chain atomically. Nodes and value
+ * records are allocated from the arena and are never unlinked, so readers
+ * need no locks or hazard pointers.
+ * Every version carries the sequence number and the record type of its
+ * write, and a read at sequence number s sees the newest version with a
+ * sequence number <= s, which may be a delete.
+ * Versions of the same key may be inserted in any order, a new version is
+ * linked into its chain at its sequence number, so chains are ordered
+ * newest first.
+ *
+ * A node is one arena allocation holding its header, its next pointers and
+ * the key bytes. A value record holds its sequence number, type and size
+ * followed by the value bytes.
+ * Nothing owns heap memory, so destroying the skiplist is a no-op and the
+ * arena frees everything by releasing its chunks.
+ */
+class skiplist {
+
+    private:
+        struct value_record;
+        struct node;
+
+    public:
+        explicit skiplist(arena& mem);
+
+        skiplist(const skiplist&) = delete;
+
+        skiplist& operator=(const skiplist&) = delete;
+
+        static const uint64_t MAX_SEQUENCE{UINT64_MAX};
+
+        uint64_t insert(std::string_view key, std::string_view value, uint64_t sequence, kv_pair::record_type type, bool& inserted);
+
+        std::optional<key_version> get(std::string_view key, uint64_t sequence = MAX_SEQUENCE) const;
+
+        /**
+         * Iterates over the keys with a version visible at the sequence
+         * number of the iterator, positioned at that version. Older versions
+         * of the current key can be walked with next_version().
+         */
+        class iterator {
+
+            public:
+                explicit iterator(const skiplist* list, uint64_t sequence = MAX_SEQUENCE);
+
+                bool valid() const;
+
+                void next();
+
+                void prev();
+
+                void seek(std::string_view target);
+
+                void seek_for_prev(std::string_view target);
+
+                void seek_to_first();
+
+                void seek_to_last();
+
+                std::string_view key() const;
+
+                std::string_view value() const;
+
+                uint64_t sequence() const;
+
+                kv_pair::record_type type() const;
+
+                bool next_version();
+
+            private:
+                const skiplist* list;
+                uint64_t snapshot;
+                node* curr{nullptr};
+                const value_record* version{nullptr};
+
+                void skip_invisible_forward();
+
+                void skip_invisible_backward();
+        };
+
+    private:
+        static const int MAX_HEIGHT{12};
+        static const uint32_t BRANCHING{4};
+
+        struct value_record {
+            std::atomic<value_record*> older;
+            uint64_t sequence;
+            uint32_t size;
+            kv_pair::record_type type;
+
+            std::string_view value() const {
+                return {reinterpret_cast<const char*>(this + 1), size};
+            }
+        };
+
+        struct node {
+            std::atomic<value_record*> value;
+            uint32_t key_size;
+            int height;
+            // Only the first height entries exist, the node is allocated
+            // with room for exactly that many pointers followed by the key.
+            std::atomic<node*> next[1];
+
+            std::string_view key() const {
+                return {reinterpret_cast<const char*>(&next[height]), key_size};
+            }
+        };
+
+        arena& mem;
+        node* head;
+        std::atomic<int> max_height{1};
+
+        node* new_node(std::string_view key, std::string_view value, uint64_t sequence, kv_pair::record_type type, int height);
+
+        value_record* new_value(std::string_view value, uint64_t sequence, kv_pair::record_type type, value_record* older);
+
+        void add_version(node* x, std::string_view value, uint64_t sequence, kv_pair::record_type type);
+
+        static const value_record* visible_version(const node* x, uint64_t sequence);
+
+        node* find_greater_or_equal(std::string_view key) const;
+
+        node* find_less_than(std::string_view key) const;
+
+        node* find_last() const;
+
+        void find_splice_for_level(std::string_view key, node* before, int level, node*& pred, node*& succ) const;
+
+        static int random_height();
+};
+
+#endif // SKIPLIST_H
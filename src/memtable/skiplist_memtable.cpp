@@ -0,0 +1,155 @@
+#include "skiplist_memtable.hpp"
+
+namespace {
+
+    /**
+     * Cursor over the skiplist. Moving backwards searches from the head
+     * since nodes only link forward.
+     */
+    class memtable_cursor : public cursor {
+
+        public:
+            explicit memtable_cursor(skiplist::iterator it): it(it) {}
+
+            bool valid() const override { return it.valid(); }
+
+            void seek_to_first() override { it.seek_to_first(); }
+
+            void seek_to_last() override { it.seek_to_last(); }
+
+            void seek(std::string_view target) override { it.seek(target); }
+
+            void seek_for_prev(std::string_view target) override { it.seek_for_prev(target); }
+
+            void next() override { it.next(); }
+
+            void prev() override { it.prev(); }
+
+            std::string_view key() const override { return it.key(); }
+
+            std::string_view value() const override { return it.value(); }
+
+            uint64_t sequence() const override { return it.sequence(); }
+
+            kv_pair::record_type type() const override { return it.type(); }
+
+        private:
+            skiplist::iterator it;
+    };
+
+} // namespace
+
+skiplist_memtable::skiplist_memtable() {
+    clear();
+}
+
+/**
+ * Insert a kv-pair as the version @param sequence of its key and account
+ * for its bytes. Replaced versions stay in the arena for older snapshots,
+ * so every version counts until the memtable is flushed. A range delete is
+ * added to the range tombstones instead.
+ */
+void skiplist_memtable::insert(const kv_pair& pair, uint64_t sequence) {
+    if (pair.type == kv_pair::RANGE_DELETE) {
+        std::lock_guard<std::mutex> guard(range_mutex);
+        range_tombstones.push_back({pair.key, pair.val, sequence});
+        fragmented.reset();
+        num_range_tombstones.fetch_add(1, std::memory_order_release);
+        byte_size.fetch_add(pair.key.size() + pair.val.size(), std::memory_order_relaxed);
+        return;
+    }
+
+    bool inserted{false};
+    uint64_t bytes = table->insert(pair.key, pair.val, sequence, pair.type, inserted);
+
+    byte_size.fetch_add(bytes, std::memory_order_relaxed);
+    if (inserted) {
+        num_entries.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Insert the kv-pairs in order with consecutive sequence numbers starting at
+ * @param first_sequence, later pairs shadow earlier ones.
+ */
+void skiplist_memtable::insert(const std::vector<kv_pair>& pairs, uint64_t first_sequence) {
+    for (const kv_pair& pair : pairs) {
+        insert(pair, first_sequence++);
+    }
+}
+
+std::optional<key_version> skiplist_memtable::get(const std::string& key, uint64_t sequence) const {
+    return table->get(key, sequence);
+}
+
+/**
+ * Return the range tombstones of the memtable, nullptr if there are none.
+ * Tombstones added later are not part of the returned list, but readers
+ * ignore them anyway since they are newer than their sequence number.
+ */
+std::shared_ptr<const range_tombstone_list> skiplist_memtable::get_range_tombstones() const {
+    if (num_range_tombstones.load(std::memory_order_acquire) == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> guard(range_mutex);
+    if (fragmented == nullptr) {
+        fragmented = std::make_shared<const range_tombstone_list>(range_tombstones);
+    }
+    return fragmented;
+}
+
+/**
+ * Return an unpositioned iterator over the entries visible at @param
+ * sequence in key order.
+ */
+skiplist::iterator skiplist_memtable::new_iterator(uint64_t sequence) const {
+    return skiplist::iterator(table.get(), sequence);
+}
+
+/**
+ * Return an unpositioned cursor over the entries visible at @param sequence
+ * in key order. The memtable has to outlive the cursor.
+ */
+std::unique_ptr<cursor> skiplist_memtable::new_cursor(uint64_t sequence) const {
+    return std::make_unique<memtable_cursor>(new_iterator(sequence));
+}
+
+/**
+ * Size of the keys and values of all versions in bytes.
+ */
+uint64_t skiplist_memtable::size() const {
+    return byte_size.load(std::memory_order_relaxed);
+}
+
+uint64_t skiplist_memtable::get_num_entries() const {
+    return num_entries.load(std::memory_order_relaxed);
+}
+
+uint64_t skiplist_memtable::get_num_range_tombstones() const {
+    return num_range_tombstones.load(std::memory_order_relaxed);
+}
+
+/**
+ * Bytes reserved by the arena, including replaced values.
+ */
+uint64_t skiplist_memtable::memory_usage() const {
+    return mem->memory_usage();
+}
+
+/**
+ * Drop all entries in O(chunks). Must not run concurrently with other
+ * operations.
+ */
+void skiplist_memtable::clear() {
+    table.reset();
+    mem = std::make_unique<arena>();
+    table = std::make_unique<skiplist>(*mem);
+
+    byte_size.store(0, std::memory_order_relaxed);
+    num_entries.store(0, std::memory_order_relaxed);
+
+    range_tombstones.clear();
+    fragmented.reset();
+    num_range_tombstones.store(0, std::memory_order_relaxed);
+}
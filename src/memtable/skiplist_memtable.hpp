@@ -0,0 +1,69 @@
+#ifndef SKIPLIST_MEMTABLE_H
+#define SKIPLIST_MEMTABLE_H
+
+#include "../utils/cursor.hpp"
+#include "../utils/range_tombstones.hpp"
+#include "../utils/types.hpp"
+#include "arena.hpp"
+#include "skiplist.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+/**
+ * In memory table of the most recent writes, backed by a lock-free skiplist
+ * whose nodes live in an arena. Inserts and lookups can run concurrently
+ * from any number of threads. Every write is kept as a version tagged with
+ * its sequence number, reads see the versions up to a given sequence number.
+ * Keys and values are copied into the arena, so clearing the table frees
+ * all entries by releasing a handful of chunks.
+ * Range deletes are kept apart from the keys as range tombstones. They are
+ * rare, so they sit in a plain vector under a mutex and are fragmented
+ * lazily on the first read after a change.
+ */
+class skiplist_memtable {
+
+    public:
+        skiplist_memtable();
+
+        void insert(const kv_pair& pair, uint64_t sequence);
+
+        void insert(const std::vector<kv_pair>& pairs, uint64_t first_sequence);
+
+        std::optional<key_version> get(const std::string& key, uint64_t sequence = skiplist::MAX_SEQUENCE) const;
+
+        std::shared_ptr<const range_tombstone_list> get_range_tombstones() const;
+
+        skiplist::iterator new_iterator(uint64_t sequence = skiplist::MAX_SEQUENCE) const;
+
+        std::unique_ptr<cursor> new_cursor(uint64_t sequence = skiplist::MAX_SEQUENCE) const;
+
+        uint64_t size() const;
+
+        uint64_t get_num_entries() const;
+
+        uint64_t get_num_range_tombstones() const;
+
+        uint64_t memory_usage() const;
+
+        void clear();
+
+    private:
+        std::unique_ptr<arena> mem;
+        std::unique_ptr<skiplist> table;
+
+        std::atomic<uint64_t> byte_size{0};
+        std::atomic<uint64_t> num_entries{0};
+
+        mutable std::mutex range_mutex;
+        std::vector<range_tombstone> range_tombstones;
+        // Fragmented range_tombstones, nullptr until read after a change.
+        mutable std::shared_ptr<const range_tombstone_list> fragmented;
+        std::atomic<uint64_t> num_range_tombstones{0};
+};
+
+#endif // SKIPLIST_MEMTABLE_H
@@ -0,0 +1,178 @@
+#include "format.hpp"
+#include <stdexcept>
+
+std::string footer::encode() const {
+    std::string dst;
+    coding::put_fixed64(dst, metaindex.offset);
+    coding::put_fixed64(dst, metaindex.size);
+    coding::put_fixed64(dst, index.offset);
+    coding::put_fixed64(dst, index.size);
+    coding::put_fixed32(dst, version);
+    coding::put_fixed64(dst, SST_MAGIC);
+    return dst;
+}
+
+/**
+ * Decode a footer from the last ENCODED_SIZE bytes of an SST.
+ * Throw if the magic number or the version do not match.
+ */
+footer footer::decode(const char* ptr) {
+    if (coding::decode_fixed64(ptr + 36) != SST_MAGIC) {
+        throw std::runtime_error("SST footer has a bad magic number");
+    }
+
+    footer result;
+    result.metaindex.offset = coding::decode_fixed64(ptr);
+    result.metaindex.size = coding::decode_fixed64(ptr + 8);
+    result.index.offset = coding::decode_fixed64(ptr + 16);
+    result.index.size = coding::decode_fixed64(ptr + 24);
+    result.version = coding::decode_fixed32(ptr + 32);
+
+    if (result.version != SST_VERSION) {
+        throw std::runtime_error("Unsupported SST version " + std::to_string(result.version));
+    }
+    return result;
+}
+
+std::string sst_properties::encode() const {
+    std::string dst;
+    coding::put_varint64(dst, num_entries);
+    coding::put_varint64(dst, run_id);
+    coding::put_varint64(dst, max_sequence);
+    return dst;
+}
+
+sst_properties sst_properties::decode(std::string_view block) {
+    sst_properties result;
+    const char* ptr = block.data();
+    const char* limit = block.data() + block.size();
+
+    // Fields are only ever appended, older SSTs end after fewer of them.
+    for (uint64_t* field : {&result.num_entries, &result.run_id, &result.max_sequence}) {
+        if (ptr == limit) {
+            break;
+        }
+        ptr = coding::get_varint64(ptr, limit, *field);
+        if (ptr == nullptr) {
+            throw std::runtime_error("SST properties block is corrupted");
+        }
+    }
+    return result;
+}
+
+block_iterator::block_iterator(std::string_view block)
+        : pos(block.data()), limit(block.data() + block.size()) {
+    next();
+}
+
+bool block_iterator::valid() const {
+    return is_valid;
+}
+
+/**
+ * Decode the next record in place. An iterator running into a truncated
+ * record becomes invalid.
+ */
+void block_iterator::next() {
+    uint64_t key_len, val_len;
+    const char* p = pos < limit ? coding::get_varint64(pos, limit, key_len) : nullptr;
+    if (p != nullptr) {
+        p = coding::get_varint64(p, limit, val_len);
+    }
+    if (p != nullptr) {
+        p = coding::get_varint64(p, limit, curr_sequence);
+    }
+    // Range deletes live in their own block, never among the records.
+    if (p != nullptr and p < limit and (uint8_t) *p != kv_pair::RANGE_DELETE and (uint8_t) *p <= kv_pair::VALUE_POINTER) {
+        curr_type = (kv_pair::record_type) (uint8_t) *p++;
+    } else {
+        p = nullptr;
+    }
+
+    // Each length is checked on its own, their sum could wrap around.
+    if (p == nullptr or key_len > (uint64_t) (limit - p) or val_len > (uint64_t) (limit - p) - key_len) {
+        is_valid = false;
+        pos = limit;
+        return;
+    }
+
+    curr_key = std::string_view(p, key_len);
+    curr_val = std::string_view(p + key_len, val_len);
+    pos = p + key_len + val_len;
+    is_valid = true;
+}
+
+std::string_view block_iterator::key() const {
+    return curr_key;
+}
+
+std::string_view block_iterator::value() const {
+    return curr_val;
+}
+
+uint64_t block_iterator::sequence() const {
+    return curr_sequence;
+}
+
+kv_pair::record_type block_iterator::type() const {
+    return curr_type;
+}
+
+void sst_format::append_record(std::string& block, std::string_view key, uint64_t sequence, kv_pair::record_type type,
+                               std::string_view value) {
+    coding::put_varint64(block, key.size());
+    coding::put_varint64(block, value.size());
+    coding::put_varint64(block, sequence);
+    block.push_back((char) type);
+    block.append(key.data(), key.size());
+    block.append(value.data(), value.size());
+}
+
+std::string sst_format::encode_index(const std::vector<index_entry>& entries) {
+    std::string block;
+    for (const index_entry& entry : entries) {
+        coding::put_length_prefixed(block, entry.first_key);
+        entry.handle.encode_to(block);
+    }
+    return block;
+}
+
+std::vector<index_entry> sst_format::decode_index(std::string_view block) {
+    std::vector<index_entry> entries;
+    const char* ptr = block.data();
+    const char* limit = block.data() + block.size();
+
+    while (ptr < limit) {
+        std::string_view key;
+        index_entry entry;
+
+        ptr = coding::get_length_prefixed(ptr, limit, key);
+        if (ptr != nullptr) {
+            ptr = entry.handle.decode_from(ptr, limit);
+        }
+        if (ptr == nullptr) {
+            throw std::runtime_error("SST index block is corrupted");
+        }
+
+        entry.first_key = std::string(key);
+        entries.push_back(std::move(entry));
+    }
+    return entries;
+}
+
+std::string sst_format::encode_metaindex(const std::map<std::string, block_handle>& meta_blocks) {
+    std::string block;
+    for (const auto& [name, handle] : meta_blocks) {
+        coding::put_length_prefixed(block, name);
+        handle.encode_to(block);
+    }
+    return block;
+}
+
+std::map<std::string, block_handle> sst_format::decode_metaindex(std::string_view block) {
+    std::map<std::string, block_handle> meta_blocks;
+    for (index_entry& entry : decode_index(block)) {
+        meta_blocks[std::move(entry.first_key)] = entry.handle;
+    }
+    return meta_blocks;
+}
@@ -0,0 +1,145 @@
+#ifndef SST_FORMAT_H
+#define SST_FORMAT_H
+
+#include "../utils/coding.hpp"
+#include "../utils/types.hpp"
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Binary layout of an SST file:
+ *
+ *   [data block 0] ... [data block n-1]
+ *   [metaindex block]
+ *   [index block]
+ *   [footer]
+ *
+ * A data block is a sequence of records
+ *   varint key_len | varint val_len | varint sequence | type byte | key | value
+ * ordered by key and, for versions of the same key, by descending sequence
+ * number. The type is a kv_pair::record_type, a delete has an empty value
+ * and a value pointer an encoded value_pointer. A block is cut once it
+ * reached BLOCK_SIZE bytes and the next record has a different key, so
+ * neither a record nor the versions of a key span two blocks.
+ * The index block holds one entry per data block: the first key of the block
+ * and the handle (offset, size) of the block.
+ * The metaindex block maps the names of optional meta blocks to their handles,
+ * e.g. FILTER_BLOCK for the serialized bloom filter, PROPERTIES_BLOCK for
+ * the statistics of the SST, RANGE_DEL_BLOCK for its range tombstones or
+ * VALUE_FILES_BLOCK for the value log files its value pointers point into.
+ * The footer has a fixed size and stores the handles of the metaindex and the
+ * index block followed by the format version and a magic number.
+ */
+
+#define SST_MAGIC 0x4c534d5353543031ULL // "LSMSST01"
+#define SST_VERSION 3
+
+// Named after the key hash, so filters built with another hash are rebuilt
+// when their SST is opened instead of missing keys.
+#define FILTER_BLOCK "filter.blocked_bloom64a"
+#define PROPERTIES_BLOCK "properties"
+#define RANGE_DEL_BLOCK "range_del"
+#define VALUE_FILES_BLOCK "value_files"
+
+struct block_handle {
+    uint64_t offset{0};
+    uint64_t size{0};
+
+    void encode_to(std::string& dst) const {
+        coding::put_varint64(dst, offset);
+        coding::put_varint64(dst, size);
+    }
+
+    const char* decode_from(const char* ptr, const char* limit) {
+        ptr = coding::get_varint64(ptr, limit, offset);
+        if (ptr == nullptr) {
+            return nullptr;
+        }
+        return coding::get_varint64(ptr, limit, size);
+    }
+};
+
+struct index_entry {
+    std::string first_key;
+    block_handle handle;
+};
+
+struct footer {
+    static const uint64_t ENCODED_SIZE{8 * 4 + 4 + 8};
+
+    block_handle metaindex;
+    block_handle index;
+    uint32_t version{SST_VERSION};
+
+    std::string encode() const;
+
+    static footer decode(const char* ptr);
+};
+
+/**
+ * Statistics of an SST, encoded as a sequence of varints. Fields are only
+ * ever appended, missing trailing fields decode to their defaults.
+ */
+struct sst_properties {
+    uint64_t num_entries{0};
+    // Id of the first SST of the sorted run this SST belongs to, 0 if the
+    // SST was written before runs were recorded.
+    uint64_t run_id{0};
+    // Largest sequence number of all records.
+    uint64_t max_sequence{0};
+
+    std::string encode() const;
+
+    static sst_properties decode(std::string_view block);
+};
+
+/**
+ * Iterate over the records of a single data block without copying them.
+ * The block has to outlive the iterator.
+ */
+class block_iterator {
+
+    public:
+        explicit block_iterator(std::string_view block);
+
+        bool valid() const;
+
+        void next();
+
+        std::string_view key() const;
+
+        std::string_view value() const;
+
+        uint64_t sequence() const;
+
+        kv_pair::record_type type() const;
+
+    private:
+        const char* pos;
+        const char* limit;
+        std::string_view curr_key;
+        std::string_view curr_val;
+        uint64_t curr_sequence{0};
+        kv_pair::record_type curr_type{kv_pair::PUT};
+        bool is_valid{false};
+};
+
+namespace sst_format {
+
+    void append_record(std::string& block, std::string_view key, uint64_t sequence, kv_pair::record_type type,
+                       std::string_view value);
+
+    std::string encode_index(const std::vector<index_entry>& entries);
+
+    std::vector<index_entry> decode_index(std::string_view block);
+
+    std::string encode_metaindex(const std::map<std::string, block_handle>& meta_blocks);
+
+    std::map<std::string, block_handle> decode_metaindex(std::string_view block);
+
+} // namespace sst_format
+
+#endif // SST_FORMAT_H
@@ -0,0 +1,227 @@
+#include "sst_reader.hpp"
+#include "../utils/io_ring.hpp"
+#include <algorithm>
+#include <stdexcept>
+
+sst_reader::sst_reader(const std::string& path, block_cache* cache)
+        : path(path), file(path), cache(cache), cache_id(block_cache::new_sst_id()) {
+    if (file.size() < footer::ENCODED_SIZE) {
+        throw std::runtime_error("SST " + path + " is too small");
+    }
+    foot = footer::decode(file.data().data() + file.size() - footer::ENCODED_SIZE);
+    meta_blocks = sst_format::decode_metaindex(read_block(foot.metaindex));
+}
+
+const footer& sst_reader::get_footer() const {
+    return foot;
+}
+
+std::vector<index_entry> sst_reader::read_index() const {
+    return sst_format::decode_index(get_block(foot.index, block_cache::HIGH, true).data);
+}
+
+/**
+ * Return the meta block registered under @param name, or nothing if the SST
+ * was written without it.
+ */
+std::optional<block_contents> sst_reader::read_meta_block(const std::string& name) const {
+    auto it = meta_blocks.find(name);
+    if (it == meta_blocks.end()) {
+        return {};
+    }
+    return get_block(it->second, block_cache::HIGH, false);
+}
+
+/**
+ * Return a view of the block inside the mapping. The view is valid as long
+ * as the reader lives.
+ */
+std::string_view sst_reader::read_block(const block_handle& handle) const {
+    if (handle.offset + handle.size > file.size()) {
+        throw std::runtime_error("Block out of bounds in SST " + path);
+    }
+    return file.data().substr(handle.offset, handle.size);
+}
+
+/**
+ * Return the block from the block cache. On a miss, read it from the mapping
+ * and insert a copy into the cache if @param fill_cache is set.
+ */
+block_contents sst_reader::get_block(const block_handle& handle, block_cache::priority pri, bool fill_cache) const {
+    if (cache == nullptr) {
+        return {read_block(handle), nullptr};
+    }
+
+    block_cache::block cached = cache->lookup(cache_id, handle.offset);
+    if (cached != nullptr) {
+        return {*cached, cached};
+    }
+
+    std::string_view mapped = read_block(handle);
+    if (not fill_cache) {
+        return {mapped, nullptr};
+    }
+
+    cached = cache->insert(cache_id, handle.offset, std::string(mapped), pri);
+    return {*cached, cached};
+}
+
+/**
+ * Return a batch of blocks and insert the missing ones into the block
+ * cache. A batch of misses is read with the io_uring of the calling thread,
+ * so all of them are in flight at once instead of faulting in the mapping
+ * one page at a time. The reads copy each block once, just like inserting
+ * it from the mapping would. If the ring fails, the reads in flight are
+ * drained before their buffers are freed. Without a cache, or without
+ * io_uring, every block is served like get_block().
+ */
+std::vector<block_contents> sst_reader::get_blocks(const std::vector<block_handle>& handles, block_cache::priority pri) const {
+    std::vector<block_contents> blocks(handles.size());
+    if (cache == nullptr) {
+        for (size_t i = 0; i < handles.size(); ++i) {
+            blocks[i] = {read_block(handles[i]), nullptr};
+        }
+        return blocks;
+    }
+
+    std::vector<size_t> misses;
+    for (size_t i = 0; i < handles.size(); ++i) {
+        block_cache::block cached = cache->lookup(cache_id, handles[i].offset);
+        if (cached != nullptr) {
+            blocks[i] = {*cached, cached};
+        } else {
+            misses.push_back(i);
+        }
+    }
+
+    io_ring* ring = misses.size() >= MIN_ASYNC_READS ? io_ring::local() : nullptr;
+    if (ring == nullptr) {
+        for (size_t i : misses) {
+            std::string_view mapped = read_block(handles[i]);
+            block_cache::block cached = cache->insert(cache_id, handles[i].offset, std::string(mapped), pri);
+            blocks[i] = {*cached, cached};
+        }
+        return blocks;
+    }
+
+    std::vector<std::string> buffers(misses.size());
+    std::vector<io_ring::read_op> ops(misses.size());
+    bool failed{false};
+    try {
+        for (size_t j = 0; j < misses.size(); ++j) {
+            const block_handle& handle = handles[misses[j]];
+            if (handle.offset + handle.size > file.size()) {
+                // Reads already queued still point into the buffers.
+                ops.resize(j);
+                failed = true;
+                break;
+            }
+            buffers[j].resize(handle.size);
+            ops[j] = {file.get_fd(), buffers[j].data(), (uint32_t) handle.size, handle.offset};
+            ring->submit(&ops[j]);
+        }
+
+        for (io_ring::read_op& op : ops) {
+            ring->wait(&op);
+            failed = failed or op.error != 0;
+        }
+    } catch (...) {
+        if (not ring->drain()) {
+            // The kernel may still write into the buffers and complete the
+            // ops, so both are leaked. Moving the vectors keeps the elements
+            // in place.
+            static_cast<void>(new std::vector<std::string>(std::move(buffers)));
+            static_cast<void>(new std::vector<io_ring::read_op>(std::move(ops)));
+        }
+        throw;
+    }
+    if (failed) {
+        throw std::runtime_error("Can not read blocks of SST " + path);
+    }
+
+    for (size_t j = 0; j < misses.size(); ++j) {
+        block_cache::block cached = cache->insert(cache_id, handles[misses[j]].offset, std::move(buffers[j]), pri);
+        blocks[misses[j]] = {*cached, cached};
+    }
+    return blocks;
+}
+
+const mapped_file& sst_reader::get_file() const {
+    return file;
+}
+
+sst_iterator::sst_iterator(const sst_reader& reader): reader(reader) {
+    index = reader.read_index();
+    load_next_block();
+    reader.get_file().begin_sequential();
+}
+
+sst_iterator::~sst_iterator() {
+    reader.get_file().end_sequential();
+}
+
+bool sst_iterator::valid() const {
+    return block_it != nullptr and block_it->valid();
+}
+
+void sst_iterator::next() {
+    block_it->next();
+    if (not block_it->valid()) {
+        load_next_block();
+    }
+}
+
+/**
+ * Position the iterator at the first record with a key >= @param target.
+ * Start at the last block whose first key is <= target.
+ */
+void sst_iterator::seek(std::string_view target) {
+    auto block = std::upper_bound(index.begin(), index.end(), target, [](std::string_view key, const index_entry& entry) {
+        return key < entry.first_key;
+    });
+    block_i = block == index.begin() ? 0 : std::distance(index.begin(), block) - 1;
+    prefetched_until = 0;
+
+    load_next_block();
+    while (valid() and key() < target) {
+        next();
+    }
+}
+
+std::string_view sst_iterator::key() const {
+    return block_it->key();
+}
+
+std::string_view sst_iterator::value() const {
+    return block_it->value();
+}
+
+uint64_t sst_iterator::sequence() const {
+    return block_it->sequence();
+}
+
+kv_pair::record_type sst_iterator::type() const {
+    return block_it->type();
+}
+
+/**
+ * Move to the next non-empty data block, or invalidate the iterator if all
+ * blocks are consumed. Keep READ_AHEAD bytes ahead of the current block
+ * faulted in.
+ */
+void sst_iterator::load_next_block() {
+    block_it.reset();
+    while (block_i < index.size()) {
+        const block_handle& handle = index[block_i++].handle;
+        if (handle.offset + READ_AHEAD / 2 >= prefetched_until) {
+            reader.get_file().will_need(handle.offset, READ_AHEAD);
+            prefetched_until = handle.offset + READ_AHEAD;
+        }
+
+        curr_block = reader.get_block(handle, block_cache::LOW, false);
+        block_it = std::make_unique<block_iterator>(curr_block.data);
+        if (block_it->valid()) {
+            return;
+        }
+    }
+}
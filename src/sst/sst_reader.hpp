@@ -0,0 +1,103 @@
+#ifndef SST_READER_H
+#define SST_READER_H
+
+#include "format.hpp"
+#include "../utils/mapped_file.hpp"
+#include "../cache/block_cache.hpp"
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * A block either cached in the block cache or viewed inside the mapping.
+ * Holding the object pins a cached block.
+ */
+struct block_contents {
+    std::string_view data;
+    block_cache::block pin;
+};
+
+/**
+ * Read the footer, the index and the data blocks of a binary SST.
+ * The file is mapped once and blocks are served straight from the mapping,
+ * or from the block cache if the reader has one.
+ */
+class sst_reader {
+
+    public:
+        sst_reader(const std::string& path, block_cache* cache);
+
+        const footer& get_footer() const;
+
+        std::vector<index_entry> read_index() const;
+
+        std::optional<block_contents> read_meta_block(const std::string& name) const;
+
+        std::string_view read_block(const block_handle& handle) const;
+
+        block_contents get_block(const block_handle& handle, block_cache::priority pri, bool fill_cache) const;
+
+        std::vector<block_contents> get_blocks(const std::vector<block_handle>& handles, block_cache::priority pri) const;
+
+        const mapped_file& get_file() const;
+
+    private:
+        // Fewer misses are cheaper to fault in from the mapping than to
+        // send through a ring.
+        static const size_t MIN_ASYNC_READS{4};
+
+        std::string path;
+        mapped_file file;
+        footer foot;
+        std::map<std::string, block_handle> meta_blocks;
+
+        block_cache* cache;
+        uint64_t cache_id;
+};
+
+/**
+ * Sequentially iterate over all records of an SST, one data block at a time.
+ * While any iterator of the SST lives the mapping is advised for sequential
+ * access, and every iterator prefetches the blocks ahead of it. Cached
+ * blocks are used, but blocks read by the scan are not inserted to keep
+ * merges from flushing the cache.
+ */
+class sst_iterator {
+
+    public:
+        explicit sst_iterator(const sst_reader& reader);
+
+        ~sst_iterator();
+
+        bool valid() const;
+
+        void next();
+
+        void seek(std::string_view target);
+
+        std::string_view key() const;
+
+        std::string_view value() const;
+
+        uint64_t sequence() const;
+
+        kv_pair::record_type type() const;
+
+    private:
+        static const uint64_t READ_AHEAD{1 << 20};
+
+        const sst_reader& reader;
+        std::vector<index_entry> index;
+        size_t block_i{0};
+        uint64_t prefetched_until{0};
+
+        block_contents curr_block;
+        std::unique_ptr<block_iterator> block_it;
+
+        void load_next_block();
+};
+
+#endif // SST_READER_H
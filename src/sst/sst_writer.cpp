@@ -0,0 +1,105 @@
+#include "sst_writer.hpp"
+#include "../utils/file_sync.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+const std::string sst_writer::TEMP_SUFFIX{".tmp"};
+
+sst_writer::sst_writer(const std::string& path): path(path), temp_path(path + TEMP_SUFFIX) {
+    file.open(temp_path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (not file) {
+        throw std::runtime_error("Can not create SST " + temp_path);
+    }
+}
+
+sst_writer::~sst_writer() {
+    if (not finished) {
+        file.close();
+        std::filesystem::remove(temp_path);
+    }
+}
+
+/**
+ * Append a record to the current data block. A block that reached
+ * BLOCK_SIZE bytes is cut before the next key, so all versions of a key
+ * end up in the same block and a lookup only has to read one block.
+ */
+void sst_writer::add(std::string_view key, uint64_t sequence, kv_pair::record_type type, std::string_view value) {
+    if (curr_block.size() >= BLOCK_SIZE and key != last_key) {
+        flush_block();
+    }
+    if (curr_block.empty()) {
+        curr_first_key = std::string(key);
+    }
+
+    sst_format::append_record(curr_block, key, sequence, type, value);
+    last_key.assign(key);
+    max_sequence = std::max(max_sequence, sequence);
+    ++num_entries;
+}
+
+/**
+ * Register a meta block which is written after the data blocks on finish().
+ */
+void sst_writer::add_meta_block(const std::string& name, const std::string& contents) {
+    meta_blocks[name] = contents;
+}
+
+/**
+ * Flush the last data block and write the meta blocks, the metaindex, the
+ * index and the footer, then move the SST to its path. The SST is durable
+ * once this returns.
+ */
+void sst_writer::finish() {
+    flush_block();
+
+    std::map<std::string, block_handle> meta_handles;
+    for (const auto& [name, contents] : meta_blocks) {
+        meta_handles[name] = write_raw(contents);
+    }
+
+    footer foot;
+    foot.metaindex = write_raw(sst_format::encode_metaindex(meta_handles));
+    foot.index = write_raw(sst_format::encode_index(index));
+    write_raw(foot.encode());
+
+    file << std::flush;
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Can not write SST " + temp_path);
+    }
+    file_sync::sync_file(temp_path);
+    std::filesystem::rename(temp_path, path);
+    finished = true;
+    file_sync::sync_parent_directory(path);
+}
+
+const std::vector<index_entry>& sst_writer::get_index() const {
+    return index;
+}
+
+uint64_t sst_writer::get_num_entries() const {
+    return num_entries;
+}
+
+uint64_t sst_writer::get_max_sequence() const {
+    return max_sequence;
+}
+
+void sst_writer::flush_block() {
+    if (curr_block.empty()) {
+        return;
+    }
+
+    index.push_back({std::move(curr_first_key), write_raw(curr_block)});
+    curr_block.clear();
+    curr_first_key.clear();
+}
+
+block_handle sst_writer::write_raw(const std::string& content) {
+    block_handle handle{offset, content.size()};
+    file.write(content.data(), (std::streamsize) content.size());
+    offset += content.size();
+    return handle;
+}
@@ -0,0 +1,67 @@
+#ifndef SST_WRITER_H
+#define SST_WRITER_H
+
+#include "format.hpp"
+#include <fstream>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Write a sorted sequence of kv-pairs as a binary SST.
+ * Keys have to be added in increasing order, versions of the same key by
+ * descending sequence number.
+ * The SST is written to a temporary file, which finish() syncs and renames
+ * to the final path, so the path only ever holds a complete and durable SST.
+ * A failed write throws, at the latest on finish(), and the temporary file
+ * is deleted with the writer unless it was finished.
+ */
+class sst_writer {
+
+    public:
+        explicit sst_writer(const std::string& path);
+
+        ~sst_writer();
+
+        sst_writer(const sst_writer&) = delete;
+
+        sst_writer& operator=(const sst_writer&) = delete;
+
+        void add(std::string_view key, uint64_t sequence, kv_pair::record_type type, std::string_view value);
+
+        void add_meta_block(const std::string& name, const std::string& contents);
+
+        void finish();
+
+        const std::vector<index_entry>& get_index() const;
+
+        uint64_t get_num_entries() const;
+
+        uint64_t get_max_sequence() const;
+
+        static const std::string TEMP_SUFFIX;
+
+    private:
+        static const uint64_t BLOCK_SIZE{4096};
+
+        std::string path;
+        std::string temp_path;
+        std::ofstream file;
+        bool finished{false};
+        uint64_t offset{0};
+        uint64_t num_entries{0};
+        uint64_t max_sequence{0};
+
+        std::string curr_block;
+        std::string curr_first_key;
+        std::string last_key;
+        std::vector<index_entry> index;
+        std::map<std::string, std::string> meta_blocks;
+
+        void flush_block();
+
+        block_handle write_raw(const std::string& content);
+};
+
+#endif // SST_WRITER_H
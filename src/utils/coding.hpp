@@ -0,0 +1,88 @@
+#ifndef CODING_H
+#define CODING_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/**
+ * Little-endian fixed width and LEB128 varint encoding helpers used by the
+ * binary on-disk formats.
+ */
+namespace coding {
+
+    inline void put_fixed32(std::string& dst, uint32_t value) {
+        char buf[4];
+        for (int i = 0; i < 4; ++i) {
+            buf[i] = (char) ((value >> (8 * i)) & 0xff);
+        }
+        dst.append(buf, 4);
+    }
+
+    inline void put_fixed64(std::string& dst, uint64_t value) {
+        char buf[8];
+        for (int i = 0; i < 8; ++i) {
+            buf[i] = (char) ((value >> (8 * i)) & 0xff);
+        }
+        dst.append(buf, 8);
+    }
+
+    inline uint32_t decode_fixed32(const char* ptr) {
+        const auto* p = reinterpret_cast<const unsigned char*>(ptr);
+        return ((uint32_t) p[0])
+            | ((uint32_t) p[1] << 8)
+            | ((uint32_t) p[2] << 16)
+            | ((uint32_t) p[3] << 24);
+    }
+
+    inline uint64_t decode_fixed64(const char* ptr) {
+        return ((uint64_t) decode_fixed32(ptr + 4) << 32) | decode_fixed32(ptr);
+    }
+
+    inline void put_varint64(std::string& dst, uint64_t value) {
+        char buf[10];
+        int len{0};
+        while (value >= 0x80) {
+            buf[len++] = (char) (value | 0x80);
+            value >>= 7;
+        }
+        buf[len++] = (char) value;
+        dst.append(buf, len);
+    }
+
+    /**
+     * Decode a varint starting at @param ptr without reading past @param limit.
+     * Return the position after the varint or nullptr if it is truncated.
+     */
+    inline const char* get_varint64(const char* ptr, const char* limit, uint64_t& value) {
+        uint64_t result{0};
+        for (uint32_t shift = 0; shift <= 63 and ptr < limit; shift += 7) {
+            uint64_t byte = *reinterpret_cast<const unsigned char*>(ptr++);
+            result |= (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                value = result;
+                return ptr;
+            }
+        }
+        return nullptr;
+    }
+
+    inline void put_length_prefixed(std::string& dst, std::string_view value) {
+        put_varint64(dst, value.size());
+        dst.append(value.data(), value.size());
+    }
+
+    inline const char* get_length_prefixed(const char* ptr, const char* limit, std::string_view& value) {
+        uint64_t len;
+        ptr = get_varint64(ptr, limit, len);
+        if (ptr == nullptr or len > (uint64_t) (limit - ptr)) {
+            return nullptr;
+        }
+        value = std::string_view(ptr, len);
+        return ptr + len;
+    }
+
+} // namespace coding
+
+#endif // CODING_H
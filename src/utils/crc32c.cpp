@@ -0,0 +1,77 @@
+#include "crc32c.hpp"
+#include <array>
+#include <cstring>
+
+// The hardware instruction needs 64 bit x86, other targets only use the
+// table.
+#if defined(__x86_64__)
+#define CRC32C_HAS_SSE42
+#include <nmmintrin.h>
+#endif
+
+namespace {
+    // Reversed Castagnoli polynomial.
+    const uint32_t POLY{0x82f63b78U};
+
+    std::array<uint32_t, 256> make_table() {
+        std::array<uint32_t, 256> table{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? POLY : 0);
+            }
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    const std::array<uint32_t, 256> TABLE = make_table();
+
+    uint32_t extend_software(uint32_t crc, const char* data, size_t n) {
+        auto* p = reinterpret_cast<const uint8_t*>(data);
+        for (size_t i = 0; i < n; ++i) {
+            crc = TABLE[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+#ifdef CRC32C_HAS_SSE42
+    /**
+     * Checksum 8 bytes per instruction and the remaining bytes one at a time.
+     */
+    __attribute__((target("sse4.2")))
+    uint32_t extend_sse42(uint32_t crc, const char* data, size_t n) {
+        uint64_t crc64 = crc;
+        while (n >= 8) {
+            uint64_t word;
+            std::memcpy(&word, data, 8);
+            crc64 = _mm_crc32_u64(crc64, word);
+            data += 8;
+            n -= 8;
+        }
+
+        auto crc32 = (uint32_t) crc64;
+        while (n > 0) {
+            crc32 = _mm_crc32_u8(crc32, (uint8_t) *data);
+            ++data;
+            --n;
+        }
+        return crc32;
+    }
+
+    bool cpu_has_sse42() {
+        static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+        return has_sse42;
+    }
+#endif
+} // namespace
+
+uint32_t crc32c::extend(uint32_t init_crc, const char* data, size_t n) {
+    uint32_t crc = ~init_crc;
+#ifdef CRC32C_HAS_SSE42
+    crc = cpu_has_sse42() ? extend_sse42(crc, data, n) : extend_software(crc, data, n);
+#else
+    crc = extend_software(crc, data, n);
+#endif
+    return ~crc;
+}
@@ -0,0 +1,36 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * CRC32C (Castagnoli polynomial) checksums for the on-disk formats.
+ * Uses the SSE4.2 crc32 instruction if the CPU supports it and a table
+ * driven implementation otherwise, both produce the same checksums.
+ */
+namespace crc32c {
+
+    // Return the crc of data[0, n) appended to the data of @param init_crc.
+    uint32_t extend(uint32_t init_crc, const char* data, size_t n);
+
+    inline uint32_t value(const char* data, size_t n) {
+        return extend(0, data, n);
+    }
+
+    // A crc of data that itself contains crcs is weak, so stored crcs are
+    // rotated and offset.
+    inline uint32_t mask(uint32_t crc) {
+        static const uint32_t MASK_DELTA{0xa282ead8U};
+        return ((crc >> 15) | (crc << 17)) + MASK_DELTA;
+    }
+
+    inline uint32_t unmask(uint32_t masked_crc) {
+        static const uint32_t MASK_DELTA{0xa282ead8U};
+        uint32_t rot = masked_crc - MASK_DELTA;
+        return (rot >> 17) | (rot << 15);
+    }
+
+} // namespace crc32c
+
+#endif // CRC32C_H
@@ -0,0 +1,43 @@
+#ifndef CURSOR_H
+#define CURSOR_H
+
+#include "types.hpp"
+#include <cstdint>
+#include <string_view>
+
+/**
+ * Position in a sorted source of kv-pairs that can move in both directions.
+ * A cursor stops at the newest visible version of every key, including
+ * deletes. Keys and values stay valid until the cursor moves.
+ */
+class cursor {
+
+    public:
+        virtual ~cursor() = default;
+
+        virtual bool valid() const = 0;
+
+        virtual void seek_to_first() = 0;
+
+        virtual void seek_to_last() = 0;
+
+        // Position at the first key >= target.
+        virtual void seek(std::string_view target) = 0;
+
+        // Position at the last key <= target.
+        virtual void seek_for_prev(std::string_view target) = 0;
+
+        virtual void next() = 0;
+
+        virtual void prev() = 0;
+
+        virtual std::string_view key() const = 0;
+
+        virtual std::string_view value() const = 0;
+
+        virtual uint64_t sequence() const = 0;
+
+        virtual kv_pair::record_type type() const = 0;
+};
+
+#endif // CURSOR_H
@@ -0,0 +1,34 @@
+#include "file_sync.hpp"
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+
+namespace {
+
+    void sync_path(const std::string& path, int flags) {
+        int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | flags);
+        if (fd < 0) {
+            throw std::runtime_error("Can not open " + path + " to sync it");
+        }
+        int result = ::fsync(fd);
+        ::close(fd);
+        if (result != 0) {
+            throw std::runtime_error("Can not sync " + path);
+        }
+    }
+
+} // namespace
+
+void file_sync::sync_file(const std::string& path) {
+    sync_path(path, 0);
+}
+
+void file_sync::sync_directory(const std::string& path) {
+    sync_path(path, O_DIRECTORY);
+}
+
+void file_sync::sync_parent_directory(const std::string& path) {
+    std::string directory = std::filesystem::path(path).parent_path().string();
+    sync_directory(directory.empty() ? "." : directory);
+}
@@ -0,0 +1,22 @@
+#ifndef FILE_SYNC_H
+#define FILE_SYNC_H
+
+#include <string>
+
+/**
+ * Make newly written files durable. A file only survives a power loss once
+ * its data and its directory entry are synced, so everything that deletes
+ * older copies of the data, e.g. a flush retiring its WAL, syncs both first.
+ */
+namespace file_sync {
+
+    void sync_file(const std::string& path);
+
+    void sync_directory(const std::string& path);
+
+    // Sync the directory holding the file at @param path.
+    void sync_parent_directory(const std::string& path);
+
+} // namespace file_sync
+
+#endif // FILE_SYNC_H
@@ -0,0 +1,235 @@
+#include "io_ring.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/**
+ * Set up a ring with @param queue_depth submission entries and map its
+ * queues. Throws if the kernel does not support io_uring or denies it.
+ */
+io_ring::io_ring(uint32_t queue_depth) {
+    io_uring_params params{};
+    ring_fd = (int) ::syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (ring_fd < 0) {
+        throw std::runtime_error("Can not set up io_uring: " + std::string(std::strerror(errno)));
+    }
+
+    sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        sq_ring_size = cq_ring_size = std::max(sq_ring_size, cq_ring_size);
+    }
+
+    sq_ring = ::mmap(nullptr, sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring == MAP_FAILED) {
+        sq_ring = nullptr;
+        release();
+        throw std::runtime_error("Can not map the io_uring submission queue");
+    }
+
+    if (single_mmap) {
+        cq_ring = sq_ring;
+    } else {
+        cq_ring = ::mmap(nullptr, cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring == MAP_FAILED) {
+            cq_ring = nullptr;
+            release();
+            throw std::runtime_error("Can not map the io_uring completion queue");
+        }
+    }
+
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    void* sqes_mem = ::mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+    if (sqes_mem == MAP_FAILED) {
+        release();
+        throw std::runtime_error("Can not map the io_uring submission entries");
+    }
+    sqes = static_cast<io_uring_sqe*>(sqes_mem);
+
+    char* sq = static_cast<char*>(sq_ring);
+    sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_entries = params.sq_entries;
+
+    char* cq = static_cast<char*>(cq_ring);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    cq_entries = params.cq_entries;
+}
+
+io_ring::~io_ring() {
+    release();
+}
+
+/**
+ * Return the ring of the calling thread, created on first use, or nullptr
+ * if io_uring is not available or the ring broke. Callers then fall back to
+ * blocking reads.
+ */
+io_ring* io_ring::local() {
+    thread_local std::unique_ptr<io_ring> ring = []() -> std::unique_ptr<io_ring> {
+        try {
+            return std::make_unique<io_ring>(QUEUE_DEPTH);
+        } catch (const std::runtime_error&) {
+            return nullptr;
+        }
+    }();
+    return ring != nullptr and not ring->broken ? ring.get() : nullptr;
+}
+
+/**
+ * Queue the read of @param op. The kernel only sees it once the submission
+ * queue runs full or someone waits. With as many reads in flight as the
+ * completion queue holds, completions are reaped first so none get lost.
+ */
+void io_ring::submit(read_op* op) {
+    op->bytes_read = 0;
+    op->error = 0;
+    op->completed = false;
+
+    while (in_flight >= cq_entries) {
+        enter(1);
+        reap();
+    }
+    queue(op);
+    ++in_flight;
+}
+
+/**
+ * Block until @param op completed. Completions of other ops reaped on the
+ * way are recorded in their ops.
+ */
+void io_ring::wait(read_op* op) {
+    while (not op->completed) {
+        enter(1);
+        reap();
+    }
+}
+
+/**
+ * Wait until all ops in flight completed, so their buffers can be freed,
+ * after submit() or wait() threw. Return false if the kernel refuses to
+ * enter the ring. The ops may still be in flight then, their buffers must
+ * never be freed and the ring is broken.
+ */
+bool io_ring::drain() {
+    try {
+        while (in_flight > 0) {
+            enter(1);
+            reap();
+        }
+        return true;
+    } catch (const std::runtime_error&) {
+        broken = true;
+        return false;
+    }
+}
+
+/**
+ * Add the remaining range of @param op to the submission queue.
+ */
+void io_ring::queue(read_op* op) {
+    if (unsubmitted == sq_entries) {
+        enter(0);
+    }
+
+    unsigned tail = *sq_tail;
+    unsigned index = tail & *sq_mask;
+    io_uring_sqe* sqe = &sqes[index];
+    std::memset(sqe, 0, sizeof(io_uring_sqe));
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = op->fd;
+    sqe->addr = reinterpret_cast<uint64_t>(op->buf + op->bytes_read);
+    sqe->len = op->size - op->bytes_read;
+    sqe->off = op->offset + op->bytes_read;
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+
+    sq_array[index] = index;
+    // Publish the entry before the new tail.
+    __atomic_store_n(sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ++unsubmitted;
+}
+
+/**
+ * Hand all queued entries to the kernel and wait for at least
+ * @param min_complete completions.
+ */
+void io_ring::enter(uint32_t min_complete) {
+    while (true) {
+        unsigned flags = min_complete > 0 ? IORING_ENTER_GETEVENTS : 0;
+        int ret = (int) ::syscall(__NR_io_uring_enter, ring_fd, unsubmitted, min_complete, flags, nullptr, 0);
+        if (ret >= 0) {
+            unsubmitted -= std::min<uint32_t>((uint32_t) ret, unsubmitted);
+            if (unsubmitted == 0 or min_complete > 0) {
+                return;
+            }
+            continue;
+        }
+        if (errno != EINTR and errno != EAGAIN and errno != EBUSY) {
+            throw std::runtime_error("io_uring_enter failed: " + std::string(std::strerror(errno)));
+        }
+    }
+}
+
+/**
+ * Consume all available completions. A short read is queued again for the
+ * rest of its range, interrupted reads are retried.
+ */
+void io_ring::reap() {
+    unsigned head = *cq_head;
+    while (head != __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+        const io_uring_cqe& cqe = cqes[head & *cq_mask];
+        auto* op = reinterpret_cast<read_op*>(cqe.user_data);
+        int res = cqe.res;
+        __atomic_store_n(cq_head, ++head, __ATOMIC_RELEASE);
+
+        if (res == -EINTR or res == -EAGAIN) {
+            queue(op);
+            continue;
+        }
+
+        --in_flight;
+        if (res < 0) {
+            op->error = -res;
+            op->completed = true;
+        } else if (res == 0) {
+            // The file ended before the range.
+            op->error = EIO;
+            op->completed = true;
+        } else {
+            op->bytes_read += (uint32_t) res;
+            if (op->bytes_read < op->size) {
+                queue(op);
+                ++in_flight;
+            } else {
+                op->completed = true;
+            }
+        }
+    }
+}
+
+void io_ring::release() {
+    if (sqes != nullptr) {
+        ::munmap(sqes, sqes_size);
+    }
+    if (cq_ring != nullptr and cq_ring != sq_ring) {
+        ::munmap(cq_ring, cq_ring_size);
+    }
+    if (sq_ring != nullptr) {
+        ::munmap(sq_ring, sq_ring_size);
+    }
+    if (ring_fd >= 0) {
+        ::close(ring_fd);
+    }
+}
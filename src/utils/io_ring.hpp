@@ -0,0 +1,94 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+
+/**
+ * Minimal io_uring submission and completion queue for asynchronous file
+ * reads, set up with the raw syscalls.
+ * Reads are queued with submit() and only handed to the kernel once the
+ * submission queue is full or a caller waits, so a batch of reads goes out
+ * with a single syscall and is served at full queue depth. Every read is
+ * described by a read_op that the caller owns, the op and its buffer have
+ * to stay alive until the op completed. Completions are matched to their op
+ * through the user data of the queue entry, so any number of independent
+ * callers on the same thread can share a ring. Short reads are resubmitted
+ * for the rest of the range.
+ * If submitting or waiting throws, the caller drains the ring before it
+ * frees the buffers of its ops. A ring that can not be drained is broken
+ * and not handed out anymore.
+ * A ring must only be used by one thread, see local().
+ */
+class io_ring {
+
+    public:
+        struct read_op {
+            int fd;
+            char* buf;
+            uint32_t size;
+            uint64_t offset;
+
+            // Filled in by the ring.
+            uint32_t bytes_read{0};
+            int error{0};
+            bool completed{false};
+        };
+
+        explicit io_ring(uint32_t queue_depth);
+
+        ~io_ring();
+
+        io_ring(const io_ring&) = delete;
+
+        io_ring& operator=(const io_ring&) = delete;
+
+        static io_ring* local();
+
+        void submit(read_op* op);
+
+        void wait(read_op* op);
+
+        bool drain();
+
+    private:
+        static const uint32_t QUEUE_DEPTH{64};
+
+        int ring_fd{-1};
+
+        void* sq_ring{nullptr};
+        size_t sq_ring_size{0};
+        unsigned* sq_head;
+        unsigned* sq_tail;
+        unsigned* sq_mask;
+        unsigned* sq_array;
+        unsigned sq_entries;
+        io_uring_sqe* sqes{nullptr};
+        size_t sqes_size{0};
+
+        void* cq_ring{nullptr};
+        size_t cq_ring_size{0};
+        unsigned* cq_head;
+        unsigned* cq_tail;
+        unsigned* cq_mask;
+        io_uring_cqe* cqes;
+        unsigned cq_entries;
+
+        // Entries in the submission queue the kernel has not seen yet.
+        uint32_t unsubmitted{0};
+        // Ops queued or submitted whose completion was not reaped yet.
+        uint32_t in_flight{0};
+        // Set if ops may still be in flight that can not be waited for.
+        bool broken{false};
+
+        void queue(read_op* op);
+
+        void enter(uint32_t min_complete);
+
+        void reap();
+
+        void release();
+};
+
+#endif // IO_RING_H
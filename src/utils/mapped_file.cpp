@@ -0,0 +1,97 @@
+#include "mapped_file.hpp"
+#include <algorithm>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+mapped_file::mapped_file(const std::string& path) {
+    fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        throw std::runtime_error("Can not open " + path);
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Can not stat " + path);
+    }
+
+    length = (uint64_t) st.st_size;
+    if (length > 0) {
+        void* addr = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            ::close(fd);
+            throw std::runtime_error("Can not mmap " + path);
+        }
+        base = static_cast<char*>(addr);
+    }
+
+    advise(RANDOM);
+}
+
+mapped_file::~mapped_file() {
+    if (base != nullptr) {
+        ::munmap(base, length);
+    }
+    ::close(fd);
+}
+
+std::string_view mapped_file::data() const {
+    return {base, length};
+}
+
+uint64_t mapped_file::size() const {
+    return length;
+}
+
+int mapped_file::get_fd() const {
+    return fd;
+}
+
+/**
+ * Point reads touch single blocks, so the kernel should not read ahead.
+ * Merges stream over the whole file and profit from aggressive read ahead.
+ */
+void mapped_file::advise(access_pattern pattern) const {
+    if (base != nullptr) {
+        ::madvise(base, length, pattern == RANDOM ? MADV_RANDOM : MADV_SEQUENTIAL);
+    }
+}
+
+/**
+ * Register a sequential reader, the first one switches the mapping to
+ * sequential access.
+ */
+void mapped_file::begin_sequential() const {
+    std::lock_guard<std::mutex> guard(advice_mutex);
+    if (sequential_readers++ == 0) {
+        advise(SEQUENTIAL);
+    }
+}
+
+/**
+ * Undo begin_sequential(), the last sequential reader switches the mapping
+ * back to random access.
+ */
+void mapped_file::end_sequential() const {
+    std::lock_guard<std::mutex> guard(advice_mutex);
+    if (--sequential_readers == 0) {
+        advise(RANDOM);
+    }
+}
+
+/**
+ * Ask the kernel to fault in [offset, offset + length) in the background.
+ */
+void mapped_file::will_need(uint64_t offset, uint64_t len) const {
+    if (base == nullptr or offset >= length) {
+        return;
+    }
+
+    static const uint64_t page_size = (uint64_t) ::sysconf(_SC_PAGESIZE);
+    uint64_t aligned = offset & ~(page_size - 1);
+    len = std::min(len + (offset - aligned), length - aligned);
+    ::madvise(base + aligned, len, MADV_WILLNEED);
+}
@@ -0,0 +1,53 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+
+/**
+ * Read-only memory mapping of a whole file. The mapping and the file
+ * descriptor live as long as the object, the descriptor serves reads that
+ * bypass the mapping.
+ * The mapping is advised for random access while no sequential reader is
+ * registered. Readers that share the mapping count themselves in and out, so
+ * a finished scan does not take the advice away from a running one.
+ */
+class mapped_file {
+
+    public:
+        enum access_pattern {RANDOM, SEQUENTIAL};
+
+        explicit mapped_file(const std::string& path);
+
+        ~mapped_file();
+
+        mapped_file(const mapped_file&) = delete;
+
+        mapped_file& operator=(const mapped_file&) = delete;
+
+        std::string_view data() const;
+
+        uint64_t size() const;
+
+        int get_fd() const;
+
+        void advise(access_pattern pattern) const;
+
+        void begin_sequential() const;
+
+        void end_sequential() const;
+
+        void will_need(uint64_t offset, uint64_t len) const;
+
+    private:
+        int fd{-1};
+        char* base{nullptr};
+        uint64_t length{0};
+
+        mutable std::mutex advice_mutex;
+        mutable uint32_t sequential_readers{0};
+};
+
+#endif // MAPPED_FILE_H
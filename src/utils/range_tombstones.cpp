@@ -0,0 +1,150 @@
+#include "range_tombstones.hpp"
+#include "coding.hpp"
+#include <algorithm>
+#include <functional>
+#include <set>
+#include <stdexcept>
+
+/**
+ * Keep @param tombstones and fragment them. Empty ranges are dropped.
+ */
+range_tombstone_list::range_tombstone_list(std::vector<range_tombstone> tombstones)
+        : tombstones(std::move(tombstones)) {
+    std::erase_if(this->tombstones, [](const range_tombstone& tombstone) {
+        return tombstone.begin >= tombstone.end;
+    });
+    build_fragments();
+}
+
+bool range_tombstone_list::empty() const {
+    return tombstones.empty();
+}
+
+size_t range_tombstone_list::size() const {
+    return tombstones.size();
+}
+
+uint64_t range_tombstone_list::get_max_sequence() const {
+    uint64_t max_sequence{0};
+    for (const range_tombstone& tombstone : tombstones) {
+        max_sequence = std::max(max_sequence, tombstone.sequence);
+    }
+    return max_sequence;
+}
+
+/**
+ * The tombstones as they were added, without fragmentation.
+ */
+const std::vector<range_tombstone>& range_tombstone_list::get_tombstones() const {
+    return tombstones;
+}
+
+/**
+ * Return the fragment covering @param key, or nullptr if no tombstone does.
+ */
+const range_tombstone_list::fragment* range_tombstone_list::find(std::string_view key) const {
+    auto it = std::upper_bound(fragments.begin(), fragments.end(), key, [](std::string_view target, const fragment& frag) {
+        return target < frag.begin;
+    });
+    if (it == fragments.begin()) {
+        return nullptr;
+    }
+    --it;
+    return key < it->end ? &*it : nullptr;
+}
+
+/**
+ * Return the largest sequence number <= @param sequence of a tombstone
+ * covering @param key, 0 if there is none. A version of the key with a
+ * smaller sequence number is deleted.
+ */
+uint64_t range_tombstone_list::max_covering(std::string_view key, uint64_t sequence) const {
+    if (fragments.empty()) {
+        return 0;
+    }
+    const fragment* frag = find(key);
+    return frag == nullptr ? 0 : newest_visible(*frag, sequence);
+}
+
+/**
+ * Return the largest sequence number <= @param sequence of @param frag, 0
+ * if all of its tombstones are newer.
+ */
+uint64_t range_tombstone_list::newest_visible(const fragment& frag, uint64_t sequence) {
+    auto it = std::lower_bound(frag.sequences.begin(), frag.sequences.end(), sequence, std::greater<>());
+    return it == frag.sequences.end() ? 0 : *it;
+}
+
+std::string range_tombstone_list::encode() const {
+    std::string block;
+    for (const range_tombstone& tombstone : tombstones) {
+        coding::put_length_prefixed(block, tombstone.begin);
+        coding::put_length_prefixed(block, tombstone.end);
+        coding::put_varint64(block, tombstone.sequence);
+    }
+    return block;
+}
+
+range_tombstone_list range_tombstone_list::decode(std::string_view block) {
+    std::vector<range_tombstone> decoded;
+    const char* ptr = block.data();
+    const char* limit = block.data() + block.size();
+
+    while (ptr < limit) {
+        std::string_view begin, end;
+        uint64_t sequence{0};
+
+        ptr = coding::get_length_prefixed(ptr, limit, begin);
+        if (ptr != nullptr) {
+            ptr = coding::get_length_prefixed(ptr, limit, end);
+        }
+        if (ptr != nullptr) {
+            ptr = coding::get_varint64(ptr, limit, sequence);
+        }
+        if (ptr == nullptr) {
+            throw std::runtime_error("Range tombstone block is corrupted");
+        }
+
+        decoded.push_back({std::string(begin), std::string(end), sequence});
+    }
+    return range_tombstone_list(std::move(decoded));
+}
+
+/**
+ * Sweep over the sorted boundaries of all tombstones. Between two
+ * neighbouring boundaries the set of covering tombstones does not change,
+ * which makes one fragment unless the set is empty.
+ */
+void range_tombstone_list::build_fragments() {
+    std::vector<std::pair<std::string_view, size_t>> starts;
+    std::vector<std::pair<std::string_view, size_t>> ends;
+    for (size_t i = 0; i < tombstones.size(); ++i) {
+        starts.emplace_back(tombstones[i].begin, i);
+        ends.emplace_back(tombstones[i].end, i);
+    }
+    std::sort(starts.begin(), starts.end());
+    std::sort(ends.begin(), ends.end());
+
+    std::multiset<uint64_t, std::greater<>> active;
+    size_t start_i{0};
+    size_t end_i{0};
+    std::string_view curr;
+    while (start_i < starts.size() or end_i < ends.size()) {
+        std::string_view next = end_i < ends.size() ? ends[end_i].first : starts[start_i].first;
+        if (start_i < starts.size()) {
+            next = std::min(next, starts[start_i].first);
+        }
+
+        if (not active.empty() and curr < next) {
+            fragments.push_back({std::string(curr), std::string(next), {active.begin(), active.end()}});
+        }
+
+        while (end_i < ends.size() and ends[end_i].first == next) {
+            active.erase(active.find(tombstones[ends[end_i++].second].sequence));
+        }
+        while (start_i < starts.size() and starts[start_i].first == next) {
+            active.insert(tombstones[starts[start_i++].second].sequence);
+        }
+        curr = next;
+    }
+}
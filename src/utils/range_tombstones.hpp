@@ -0,0 +1,67 @@
+#ifndef RANGE_TOMBSTONES_H
+#define RANGE_TOMBSTONES_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * Deletes all keys in [begin, end) written before @param sequence.
+ */
+struct range_tombstone {
+    std::string begin;
+    std::string end;
+    uint64_t sequence;
+};
+
+/**
+ * Immutable set of range tombstones, split into fragments that do not
+ * overlap: every boundary of a tombstone starts a new fragment, and a
+ * fragment holds the sequence numbers of all tombstones covering it, newest
+ * first. A lookup is one binary search over the fragments, no matter how
+ * many tombstones overlap.
+ * Encoded, e.g. as the range tombstone block of an SST, as a sequence of
+ *   length prefixed begin | length prefixed end | varint sequence
+ * of the original tombstones.
+ */
+class range_tombstone_list {
+
+    public:
+        struct fragment {
+            std::string begin;
+            std::string end;
+            std::vector<uint64_t> sequences;
+        };
+
+        range_tombstone_list() = default;
+
+        explicit range_tombstone_list(std::vector<range_tombstone> tombstones);
+
+        bool empty() const;
+
+        size_t size() const;
+
+        uint64_t get_max_sequence() const;
+
+        const std::vector<range_tombstone>& get_tombstones() const;
+
+        const fragment* find(std::string_view key) const;
+
+        uint64_t max_covering(std::string_view key, uint64_t sequence) const;
+
+        static uint64_t newest_visible(const fragment& frag, uint64_t sequence);
+
+        std::string encode() const;
+
+        static range_tombstone_list decode(std::string_view block);
+
+    private:
+        std::vector<range_tombstone> tombstones;
+        // Sorted by begin, without gaps inside a fragment.
+        std::vector<fragment> fragments;
+
+        void build_fragments();
+};
+
+#endif // RANGE_TOMBSTONES_H
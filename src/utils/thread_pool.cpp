@@ -0,0 +1,95 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+#include <pthread.h>
+#include <sched.h>
+#include <stdexcept>
+#include <string>
+
+/**
+ * Start @param num_threads workers, at least one. With @param cpus worker i
+ * is pinned to cpus[i % cpus.size()].
+ */
+thread_pool::thread_pool(uint32_t num_threads, const std::vector<uint32_t>& cpus) {
+    num_threads = std::max<uint32_t>(num_threads, 1);
+    try {
+        for (uint32_t i = 0; i < num_threads; ++i) {
+            workers.emplace_back(&thread_pool::work, this);
+            if (not cpus.empty()) {
+                pin_thread(workers.back(), {cpus[i % cpus.size()]});
+            }
+        }
+    } catch (...) {
+        join_workers();
+        throw;
+    }
+}
+
+thread_pool::~thread_pool() {
+    join_workers();
+}
+
+std::future<void> thread_pool::submit(std::function<void()> task) {
+    std::packaged_task<void()> packaged(std::move(task));
+    std::future<void> result = packaged.get_future();
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        tasks.push_back(std::move(packaged));
+    }
+    cv.notify_one();
+    return result;
+}
+
+size_t thread_pool::size() const {
+    return workers.size();
+}
+
+/**
+ * Restrict @param thread to run on @param cpus only. An empty set leaves
+ * the thread unpinned.
+ */
+void thread_pool::pin_thread(std::thread& thread, const std::vector<uint32_t>& cpus) {
+    if (cpus.empty()) {
+        return;
+    }
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (uint32_t cpu : cpus) {
+        if (cpu >= CPU_SETSIZE) {
+            throw std::runtime_error("CPU " + std::to_string(cpu) + " is out of range.");
+        }
+        CPU_SET(cpu, &set);
+    }
+
+    int error = pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set);
+    if (error != 0) {
+        throw std::runtime_error("Could not pin thread to its CPUs, error " + std::to_string(error) + ".");
+    }
+}
+
+void thread_pool::join_workers() {
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        stop = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void thread_pool::work() {
+    while (true) {
+        std::packaged_task<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(mutex);
+            cv.wait(guard, [this] { return stop or not tasks.empty(); });
+            if (tasks.empty()) {
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads running submitted tasks in FIFO order.
+ * Exceptions of a task are handed to the caller through its future.
+ * Queued tasks are finished before the pool is destroyed.
+ */
+class thread_pool {
+
+    public:
+        explicit thread_pool(uint32_t num_threads, const std::vector<uint32_t>& cpus = {});
+
+        ~thread_pool();
+
+        thread_pool(const thread_pool&) = delete;
+
+        thread_pool& operator=(const thread_pool&) = delete;
+
+        std::future<void> submit(std::function<void()> task);
+
+        size_t size() const;
+
+        static void pin_thread(std::thread& thread, const std::vector<uint32_t>& cpus);
+
+    private:
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::packaged_task<void()>> tasks;
+        bool stop{false};
+        std::vector<std::thread> workers;
+
+        void join_workers();
+
+        void work();
+};
+
+#endif // THREAD_POOL_H
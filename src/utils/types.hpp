@@ -1,35 +1,29 @@
 #ifndef TYPES_H
 #define TYPES_H
 
+#include <cstdint>
 #include <string>
 
-// Bad solution since this value is not allowed to be used by the user
-#define TOMBSTONE "+++TOMBSTONE+++"
-#define SEPERATOR ','
-
 struct kv_pair {
+    // Kind of a write, stored as one byte with every record in the WAL, the
+    // memtable and the SSTs. A delete has an empty value, a range delete
+    // removes all keys in [key, val). A value pointer is a put whose value
+    // was moved to the value log, only SSTs hold them.
+    enum record_type : uint8_t {
+        PUT,
+        DELETE,
+        RANGE_DELETE,
+        VALUE_POINTER
+    };
+
     std::string key;
     std::string val;
+    record_type type{PUT};
 
     bool empty() const {
         return key.empty() and val.empty();
     }
 
-    std::string to_log_entry() const {
-        return key + SEPERATOR + val + "\n";
-    }
-
-    static kv_pair split_log_entry(const std::string& line) {
-        if (line.empty()) {
-            return {"", ""};
-        }
-
-        size_t seperator_pos = line.find(SEPERATOR);
-        std::string key = line.substr(0, seperator_pos);
-        std::string value = line.substr(seperator_pos + 1, line.size() - seperator_pos);
-        return {key, value};
-    }
-
     std::strong_ordering operator <=>(const kv_pair& other) const {
         if (key == other.key) {
             return std::strong_ordering::equal;
@@ -45,4 +39,13 @@ struct kv_pair {
     bool operator==(const kv_pair& other) const {return key == other.key;}
 };
 
+/**
+ * Newest version of a key visible in one source, e.g. a memtable or an SST.
+ */
+struct key_version {
+    kv_pair::record_type type;
+    uint64_t sequence;
+    std::string value;
+};
+
 #endif // TYPES_H
\ No newline at end of file
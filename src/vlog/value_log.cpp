@@ -0,0 +1,342 @@
+#include "value_log.hpp"
+#include "../utils/coding.hpp"
+#include "../utils/crc32c.hpp"
+#include "../utils/file_sync.hpp"
+#include <algorithm>
+#include <filesystem>
+#include <stdexcept>
+
+std::string value_pointer::encode() const {
+    std::string encoded;
+    coding::put_varint64(encoded, file_number);
+    coding::put_varint64(encoded, offset);
+    coding::put_varint64(encoded, size);
+    return encoded;
+}
+
+value_pointer value_pointer::decode(std::string_view encoded) {
+    value_pointer pointer;
+    const char* ptr = encoded.data();
+    const char* limit = encoded.data() + encoded.size();
+
+    ptr = coding::get_varint64(ptr, limit, pointer.file_number);
+    if (ptr != nullptr) {
+        ptr = coding::get_varint64(ptr, limit, pointer.offset);
+    }
+    if (ptr != nullptr) {
+        ptr = coding::get_varint64(ptr, limit, pointer.size);
+    }
+    if (ptr == nullptr) {
+        throw std::runtime_error("Value pointer is corrupted");
+    }
+    return pointer;
+}
+
+value_log_file::value_log_file(const std::string& path, uint64_t number)
+        : path(path), number(number), file(path) {}
+
+/**
+ * No SST points into the file anymore.
+ */
+value_log_file::~value_log_file() {
+    if (not file_kept.load(std::memory_order_relaxed)) {
+        std::filesystem::remove(path);
+    }
+}
+
+/**
+ * Return the value at @param pointer straight from the mapping after
+ * checking its crc.
+ */
+std::string_view value_log_file::read(const value_pointer& pointer) const {
+    std::string_view data = file.data();
+    if (pointer.offset > data.size() or HEADER_SIZE + pointer.size > data.size() - pointer.offset) {
+        throw std::runtime_error("Value pointer is out of range of " + path);
+    }
+
+    const char* record = data.data() + pointer.offset;
+    std::string_view value(record + HEADER_SIZE, pointer.size);
+    if (crc32c::unmask(coding::decode_fixed32(record)) != crc32c::value(value.data(), value.size())) {
+        throw std::runtime_error("Value log file " + path + " is corrupted");
+    }
+    return value;
+}
+
+uint64_t value_log_file::get_number() const {
+    return number;
+}
+
+uint64_t value_log_file::get_file_size() const {
+    return file.size();
+}
+
+uint64_t value_log_file::get_live_bytes() const {
+    return live_bytes.load(std::memory_order_relaxed);
+}
+
+void value_log_file::add_live_bytes(uint64_t bytes) {
+    live_bytes.fetch_add(bytes, std::memory_order_relaxed);
+}
+
+void value_log_file::remove_live_bytes(uint64_t bytes) {
+    live_bytes.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+/**
+ * Leave the file on disk when the object is destroyed.
+ */
+void value_log_file::keep_file() {
+    file_kept.store(true, std::memory_order_relaxed);
+}
+
+value_log_writer::value_log_writer(value_log& log, uint64_t number)
+        : log(log), number(number), path(log.get_file_path(number)) {
+    file.open(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (not file) {
+        throw std::runtime_error("Can not create value log file " + path);
+    }
+}
+
+value_log_writer::~value_log_writer() {
+    if (not finished) {
+        file.close();
+        std::filesystem::remove(path);
+    }
+}
+
+value_pointer value_log_writer::add(std::string_view value) {
+    std::string header;
+    coding::put_fixed32(header, crc32c::mask(crc32c::value(value.data(), value.size())));
+    file.write(header.data(), (std::streamsize) header.size());
+    file.write(value.data(), (std::streamsize) value.size());
+
+    value_pointer pointer{number, offset, value.size()};
+    offset += value_log_file::HEADER_SIZE + value.size();
+    return pointer;
+}
+
+/**
+ * Close the file, sync it and its directory entry, map it and register it
+ * with the value log. The SST pointing into the file is only written
+ * afterwards, so a durable SST never points into a lost file.
+ * All of the file counts as live before it is registered, so GC does not
+ * take it for garbage while its SST is still being written. The SST drops
+ * that count once it acquired its own.
+ */
+std::shared_ptr<value_log_file> value_log_writer::finish() {
+    file << std::flush;
+    file.close();
+    if (file.fail()) {
+        throw std::runtime_error("Can not write value log file " + path);
+    }
+    file_sync::sync_file(path);
+    file_sync::sync_parent_directory(path);
+
+    auto finished_file = std::make_shared<value_log_file>(path, number);
+    finished_file->add_live_bytes(offset);
+    log.register_file(finished_file);
+    finished = true;
+    return finished_file;
+}
+
+uint64_t value_log_writer::get_file_size() const {
+    return offset;
+}
+
+/**
+ * Count @param bytes more that the SST points to in @param file.
+ */
+void value_file_set::add(const std::shared_ptr<value_log_file>& file, uint64_t bytes) {
+    auto it = std::lower_bound(files.begin(), files.end(), file->get_number(), [](const auto& entry, uint64_t number) {
+        return entry.first->get_number() < number;
+    });
+    if (it != files.end() and it->first->get_number() == file->get_number()) {
+        it->second += bytes;
+    } else {
+        files.insert(it, {file, bytes});
+    }
+}
+
+/**
+ * Return the file with @param number, which the SST has to point into.
+ */
+std::shared_ptr<value_log_file> value_file_set::get(uint64_t number) const {
+    auto it = std::lower_bound(files.begin(), files.end(), number, [](const auto& entry, uint64_t target) {
+        return entry.first->get_number() < target;
+    });
+    if (it == files.end() or it->first->get_number() != number) {
+        throw std::runtime_error("Value pointer into unknown value log file " + std::to_string(number));
+    }
+    return it->first;
+}
+
+/**
+ * Resolve the value pointer stored in a VALUE_POINTER record. The value
+ * lives as long as the set.
+ */
+std::string_view value_file_set::read(std::string_view encoded_pointer) const {
+    value_pointer pointer = value_pointer::decode(encoded_pointer);
+    return get(pointer.file_number)->read(pointer);
+}
+
+bool value_file_set::empty() const {
+    return files.empty();
+}
+
+/**
+ * Whether the SST points into any of the files with @param numbers.
+ */
+bool value_file_set::refers_to_any(const std::set<uint64_t>& numbers) const {
+    return std::any_of(files.begin(), files.end(), [&](const auto& entry) {
+        return numbers.contains(entry.first->get_number());
+    });
+}
+
+/**
+ * Count the bytes of the set as live in their files, once the SST is
+ * written or restored.
+ */
+void value_file_set::acquire() const {
+    for (const auto& [file, bytes] : files) {
+        file->add_live_bytes(bytes);
+    }
+}
+
+/**
+ * Undo acquire() once the SST is gone.
+ */
+void value_file_set::release() const {
+    for (const auto& [file, bytes] : files) {
+        file->remove_live_bytes(bytes);
+    }
+}
+
+std::string value_file_set::encode() const {
+    std::string block;
+    for (const auto& [file, bytes] : files) {
+        coding::put_varint64(block, file->get_number());
+        coding::put_varint64(block, bytes);
+    }
+    return block;
+}
+
+value_file_set value_file_set::decode(std::string_view block, const value_log& log) {
+    value_file_set decoded;
+    const char* ptr = block.data();
+    const char* limit = block.data() + block.size();
+
+    while (ptr < limit) {
+        uint64_t number{0};
+        uint64_t bytes{0};
+        ptr = coding::get_varint64(ptr, limit, number);
+        if (ptr != nullptr) {
+            ptr = coding::get_varint64(ptr, limit, bytes);
+        }
+        if (ptr == nullptr) {
+            throw std::runtime_error("Value files block is corrupted");
+        }
+        decoded.add(log.get_file(number), bytes);
+    }
+    return decoded;
+}
+
+/**
+ * Values of at least @param threshold bytes are separated, 0 keeps all
+ * values in the SSTs. Files are collected once @param gc_ratio of them is
+ * garbage.
+ */
+value_log::value_log(const std::string& directory, uint64_t threshold, double gc_ratio)
+        : directory(directory), threshold(threshold), gc_ratio(gc_ratio) {}
+
+/**
+ * Open all files of the directory. They are held until release_restored(),
+ * so the SSTs can look up the files they point into while they are
+ * restored.
+ */
+void value_log::restore() {
+    std::filesystem::create_directories(directory);
+
+    std::lock_guard<std::mutex> guard(mutex);
+    for (const auto& entry : std::filesystem::directory_iterator(directory)) {
+        if (entry.path().extension() != ".vlog") {
+            continue;
+        }
+        uint64_t number = std::stoull(entry.path().stem().string());
+        auto file = std::make_shared<value_log_file>(entry.path().string(), number);
+        files[number] = file;
+        restored.push_back(file);
+        next_number = std::max<uint64_t>(next_number, number + 1);
+    }
+}
+
+/**
+ * Drop the files no restored SST points into, e.g. files of a flush or
+ * merge that did not finish before a crash.
+ */
+void value_log::release_restored() {
+    std::vector<std::shared_ptr<value_log_file>> released;
+    {
+        std::lock_guard<std::mutex> guard(mutex);
+        released.swap(restored);
+    }
+}
+
+bool value_log::is_separated(std::string_view value) const {
+    return threshold > 0 and value.size() >= threshold;
+}
+
+std::unique_ptr<value_log_writer> value_log::new_writer() {
+    return std::make_unique<value_log_writer>(*this, next_number++);
+}
+
+void value_log::register_file(const std::shared_ptr<value_log_file>& file) {
+    std::lock_guard<std::mutex> guard(mutex);
+    std::erase_if(files, [](const auto& entry) { return entry.second.expired(); });
+    files[file->get_number()] = file;
+}
+
+std::shared_ptr<value_log_file> value_log::get_file(uint64_t number) const {
+    std::lock_guard<std::mutex> guard(mutex);
+    auto it = files.find(number);
+    std::shared_ptr<value_log_file> file = it == files.end() ? nullptr : it->second.lock();
+    if (file == nullptr) {
+        throw std::runtime_error("Value log file " + get_file_path(number) + " is missing");
+    }
+    return file;
+}
+
+/**
+ * Return the files of which at least gc_ratio is garbage.
+ */
+std::set<uint64_t> value_log::get_gc_files() const {
+    std::set<uint64_t> gc_files;
+    std::lock_guard<std::mutex> guard(mutex);
+    for (const auto& [number, entry] : files) {
+        std::shared_ptr<value_log_file> file = entry.lock();
+        if (file == nullptr or file->get_file_size() == 0) {
+            continue;
+        }
+        uint64_t live = std::min(file->get_live_bytes(), file->get_file_size());
+        if ((double) (file->get_file_size() - live) >= gc_ratio * (double) file->get_file_size()) {
+            gc_files.insert(number);
+        }
+    }
+    return gc_files;
+}
+
+std::string value_log::get_file_path(uint64_t number) const {
+    return (std::filesystem::path(directory) / (std::to_string(number) + ".vlog")).string();
+}
+
+/**
+ * Keep all files on disk once their SSTs are gone, the tree is closed and
+ * restores them on its next open.
+ */
+void value_log::keep_files() {
+    std::lock_guard<std::mutex> guard(mutex);
+    for (const auto& [number, entry] : files) {
+        if (std::shared_ptr<value_log_file> file = entry.lock()) {
+            file->keep_file();
+        }
+    }
+}
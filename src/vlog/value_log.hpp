@@ -0,0 +1,189 @@
+#ifndef VALUE_LOG_H
+#define VALUE_LOG_H
+
+#include "../utils/mapped_file.hpp"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+/**
+ * Location of a value in the value log. SSTs store it encoded as
+ *   varint file number | varint offset | varint size
+ * in place of the value of a kv_pair::VALUE_POINTER record.
+ */
+struct value_pointer {
+    uint64_t file_number{0};
+    uint64_t offset{0};
+    uint64_t size{0};
+
+    std::string encode() const;
+
+    static value_pointer decode(std::string_view encoded);
+};
+
+/**
+ * Immutable file of the value log, mapped for reading. Every value is
+ * stored as
+ *   fixed32 masked crc32c of the value | value
+ * and a pointer addresses the crc of its value.
+ * SSTs hold the files they point into, and the file is deleted with the
+ * object once the last of them is gone, unless the tree was closed. Live
+ * bytes count the records the live SSTs point to, everything else in the
+ * file is garbage.
+ */
+class value_log_file {
+
+    public:
+        static const uint64_t HEADER_SIZE{4};
+
+        value_log_file(const std::string& path, uint64_t number);
+
+        ~value_log_file();
+
+        value_log_file(const value_log_file&) = delete;
+
+        value_log_file& operator=(const value_log_file&) = delete;
+
+        std::string_view read(const value_pointer& pointer) const;
+
+        uint64_t get_number() const;
+
+        uint64_t get_file_size() const;
+
+        uint64_t get_live_bytes() const;
+
+        void add_live_bytes(uint64_t bytes);
+
+        void remove_live_bytes(uint64_t bytes);
+
+        void keep_file();
+
+    private:
+        std::string path;
+        uint64_t number;
+        mapped_file file;
+        std::atomic<uint64_t> live_bytes{0};
+        std::atomic<bool> file_kept{false};
+};
+
+class value_log;
+
+/**
+ * Appends the values of one flush or merge to a new value log file, which
+ * is registered with the value log once it is finished. A file that is
+ * never finished is deleted with the writer.
+ */
+class value_log_writer {
+
+    public:
+        value_log_writer(value_log& log, uint64_t number);
+
+        ~value_log_writer();
+
+        value_log_writer(const value_log_writer&) = delete;
+
+        value_log_writer& operator=(const value_log_writer&) = delete;
+
+        value_pointer add(std::string_view value);
+
+        std::shared_ptr<value_log_file> finish();
+
+        uint64_t get_file_size() const;
+
+    private:
+        value_log& log;
+        uint64_t number;
+        std::string path;
+        std::ofstream file;
+        uint64_t offset{0};
+        bool finished{false};
+};
+
+/**
+ * The value log files an SST points into, together with the bytes it
+ * points to in every file. Encoded, as the VALUE_FILES_BLOCK of the SST, as
+ * pairs of varint file number | varint bytes.
+ */
+class value_file_set {
+
+    public:
+        void add(const std::shared_ptr<value_log_file>& file, uint64_t bytes);
+
+        std::shared_ptr<value_log_file> get(uint64_t number) const;
+
+        std::string_view read(std::string_view encoded_pointer) const;
+
+        bool empty() const;
+
+        bool refers_to_any(const std::set<uint64_t>& numbers) const;
+
+        void acquire() const;
+
+        void release() const;
+
+        std::string encode() const;
+
+        static value_file_set decode(std::string_view block, const value_log& log);
+
+    private:
+        // Sorted by file number.
+        std::vector<std::pair<std::shared_ptr<value_log_file>, uint64_t>> files;
+};
+
+/**
+ * Key-value separation as in WiscKey: flushes and merges move values of at
+ * least threshold bytes out of the SST into a value log file and only
+ * write a pointer to it, so later merges copy the pointer instead of the
+ * value. Every flush or merge that moves values writes its own file, which
+ * is never appended to afterwards.
+ * Values go stale as their keys are overwritten, deleted or compacted
+ * away. Once at least gc_ratio of a file is garbage, merges rewrite the
+ * values they still find in it into their own file and update the
+ * pointers, and the old file is deleted once no SST points into it.
+ * lsm_tree::collect_value_log_garbage() does the same for files no merge
+ * comes across by rewriting the SSTs that point into them.
+ */
+class value_log {
+
+    public:
+        value_log(const std::string& directory, uint64_t threshold, double gc_ratio);
+
+        void restore();
+
+        void release_restored();
+
+        bool is_separated(std::string_view value) const;
+
+        std::unique_ptr<value_log_writer> new_writer();
+
+        void register_file(const std::shared_ptr<value_log_file>& file);
+
+        std::shared_ptr<value_log_file> get_file(uint64_t number) const;
+
+        std::set<uint64_t> get_gc_files() const;
+
+        std::string get_file_path(uint64_t number) const;
+
+        void keep_files();
+
+    private:
+        std::string directory;
+        uint64_t threshold;
+        double gc_ratio;
+        std::atomic<uint64_t> next_number{0};
+
+        mutable std::mutex mutex;
+        std::map<uint64_t, std::weak_ptr<value_log_file>> files;
+        // Files found on disk, held until the restored SSTs took theirs.
+        std::vector<std::shared_ptr<value_log_file>> restored;
+};
+
+#endif // VALUE_LOG_H
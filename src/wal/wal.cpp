@@ -1,36 +1,302 @@
 #include "wal.hpp"
+#include "../utils/coding.hpp"
+#include "../utils/crc32c.hpp"
+#include "../utils/file_sync.hpp"
+#include "../utils/mapped_file.hpp"
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
 
-write_ahead_log::write_ahead_log(const std::string& filename) {
-    this->filename = filename;
-    wal_file.open(filename, std::ios::in | std::ios::out | std::ios::app);
+write_ahead_log::write_ahead_log(const std::string& filename, sync_mode mode, uint64_t sync_interval_ms)
+        : filename(filename), mode(mode), sync_interval(sync_interval_ms) {
+    fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Can not open WAL " + filename);
+    }
+
+    struct stat st{};
+    if (::fstat(fd, &st) != 0) {
+        ::close(fd);
+        throw std::runtime_error("Can not stat WAL " + filename);
+    }
+    file_size = (uint64_t) st.st_size;
+    preallocated_until = file_size;
+
+    // A synced record is only durable once the directory entry of a new
+    // log is.
+    if (mode != NONE) {
+        try {
+            file_sync::sync_parent_directory(filename);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+    }
+
+    if (mode == INTERVAL) {
+        sync_thread = std::thread(&write_ahead_log::sync_periodically, this);
+    }
+}
+
+write_ahead_log::~write_ahead_log() {
+    stop_sync_thread();
+    if (fd >= 0) {
+        if (mode != NONE) {
+            ::fdatasync(fd);
+        }
+        ::close(fd);
+    }
+}
+
+/**
+ * Start the payload of a record whose first entry gets @param first_sequence.
+ */
+void write_ahead_log::begin_payload(std::string& payload, uint64_t first_sequence) {
+    coding::put_fixed64(payload, first_sequence);
+}
+
+/**
+ * Append an entry to the payload of a record.
+ */
+void write_ahead_log::encode_entry(std::string& payload, const kv_pair& pair) {
+    payload.push_back((char) pair.type);
+    coding::put_varint64(payload, pair.key.size());
+    coding::put_varint64(payload, pair.val.size());
+    payload.append(pair.key);
+    payload.append(pair.val);
+}
+
+/**
+ * Sync the log. A failed sync may have dropped dirty pages, so records that
+ * look written may be lost and the log refuses all further appends.
+ */
+void write_ahead_log::sync() {
+    if (::fdatasync(fd) != 0) {
+        auto error = std::make_exception_ptr(std::runtime_error("Can not sync WAL " + filename));
+        fail(error);
+        std::rethrow_exception(error);
+    }
 }
 
-write_ahead_log::~write_ahead_log() = default;
+/**
+ * Body of the sync thread in INTERVAL mode. Sleeps for the sync interval
+ * and syncs if records were appended since the last sync, so the last
+ * records before an idle period are synced as well.
+ */
+void write_ahead_log::sync_periodically() {
+    std::unique_lock<std::mutex> lock(sync_mutex);
+    while (not stop_syncing) {
+        sync_cv.wait_for(lock, sync_interval, [this] { return stop_syncing; });
+        if (not unsynced or failure) {
+            continue;
+        }
+
+        unsynced = false;
+        lock.unlock();
+        bool synced = ::fdatasync(fd) == 0;
+        lock.lock();
+        if (not synced and not failure) {
+            failure = std::make_exception_ptr(std::runtime_error("Can not sync WAL " + filename));
+        }
+    }
+}
+
+void write_ahead_log::stop_sync_thread() {
+    {
+        std::lock_guard<std::mutex> guard(sync_mutex);
+        stop_syncing = true;
+    }
+    sync_cv.notify_all();
+    if (sync_thread.joinable()) {
+        sync_thread.join();
+    }
+}
+
+/**
+ * Return the error that makes the log refuse appends, nullptr if there is
+ * none. Records the log acknowledged may be lost after such an error.
+ */
+std::exception_ptr write_ahead_log::get_failure() {
+    std::lock_guard<std::mutex> guard(sync_mutex);
+    return failure;
+}
 
-void write_ahead_log::append(const std::string& content) {
-    if (wal_file.is_open()) {
-        wal_file << content;
+/**
+ * Refuse all further appends with @param error, the first error is kept.
+ */
+void write_ahead_log::fail(std::exception_ptr error) {
+    std::lock_guard<std::mutex> guard(sync_mutex);
+    if (not failure) {
+        failure = error;
     }
 }
 
 void write_ahead_log::clear() {
-    std::filesystem::resize_file(filename, 0);
+    truncate(0);
+    preallocated_until = 0;
 }
 
-void write_ahead_log::repopulate_memtable(red_black_tree& memtable) const {
-    std::ifstream wal_tmp;
-    wal_tmp.open(filename);
+/**
+ * Close and delete the log once its memtable is persisted in an SST.
+ */
+void write_ahead_log::remove() {
+    stop_sync_thread();
+    ::close(fd);
+    fd = -1;
+    std::filesystem::remove(filename);
+}
+
+/**
+ * Replay all intact records into @param memtable. Replay stops at the first
+ * record that is truncated or fails its checksum, which is where the log
+ * was torn by a crash. The log is cut there so new records directly follow
+ * the last intact one. A record is only applied if all of its entries
+ * decode.
+ * Return the sequence number of the last applied entry, 0 if there is none.
+ */
+uint64_t write_ahead_log::repopulate_memtable(skiplist_memtable& memtable) {
+    if (file_size == 0) {
+        return 0;
+    }
+
+    mapped_file file(filename);
+    file.advise(mapped_file::SEQUENTIAL);
+    const char* begin = file.data().data();
+    const char* limit = begin + file.data().size();
+    const char* pos = begin;
+
+    std::vector<kv_pair> entries;
+    uint64_t last_sequence{0};
+    while ((uint64_t) (limit - pos) >= HEADER_SIZE) {
+        uint32_t expected_crc = crc32c::unmask(coding::decode_fixed32(pos));
+        uint32_t length = coding::decode_fixed32(pos + 4);
+        if (length > (uint64_t) (limit - pos) - HEADER_SIZE) {
+            break;
+        }
+
+        const char* payload = pos + HEADER_SIZE;
+        if (crc32c::extend(crc32c::value(pos + 4, 4), payload, length) != expected_crc or length < 8) {
+            break;
+        }
+
+        uint64_t first_sequence = coding::decode_fixed64(payload);
+        entries.clear();
+        const char* p = payload + 8;
+        const char* payload_end = payload + length;
+        while (p != nullptr and p < payload_end) {
+            auto type = (kv_pair::record_type) (uint8_t) *p++;
+            uint64_t key_len, val_len;
+            p = type <= kv_pair::RANGE_DELETE ? coding::get_varint64(p, payload_end, key_len) : nullptr;
+            if (p != nullptr) {
+                p = coding::get_varint64(p, payload_end, val_len);
+            }
+            if (p == nullptr or key_len > (uint64_t) (payload_end - p) or val_len > (uint64_t) (payload_end - p) - key_len) {
+                p = nullptr;
+                break;
+            }
+            entries.push_back({std::string(p, key_len), std::string(p + key_len, val_len), type});
+            p += key_len + val_len;
+        }
+        if (p == nullptr) {
+            break;
+        }
+
+        memtable.insert(entries, first_sequence);
+        if (not entries.empty()) {
+            last_sequence = first_sequence + entries.size() - 1;
+        }
+        pos = payload_end;
+    }
+
+    if ((uint64_t) (pos - begin) < file_size) {
+        truncate(pos - begin);
+    }
+    return last_sequence;
+}
+
+/**
+ * Frame the payload and write the record with a single write(2), then sync
+ * according to the sync mode. If the write fails, the file is truncated to
+ * its last complete record.
+ */
+void write_ahead_log::append(std::string_view payload) {
+    if (std::exception_ptr error = get_failure()) {
+        std::rethrow_exception(error);
+    }
+
+    std::string length;
+    coding::put_fixed32(length, (uint32_t) payload.size());
+    uint32_t crc = crc32c::extend(crc32c::value(length.data(), length.size()), payload.data(), payload.size());
 
-    std::string line;
-    std::string key, value;
+    std::string record;
+    record.reserve(HEADER_SIZE + payload.size());
+    coding::put_fixed32(record, crc32c::mask(crc));
+    record.append(length);
+    record.append(payload);
 
-    while (std::getline(wal_tmp, line)) {
-        size_t seperator_pos = line.find(SEPERATOR);
-        key = line.substr(0, seperator_pos);
-        value = line.substr(seperator_pos + 1, line.size());
+    preallocate(file_size + record.size());
+
+    const char* data = record.data();
+    size_t left = record.size();
+    while (left > 0) {
+        ssize_t written = ::write(fd, data, left);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (::ftruncate(fd, (off_t) file_size) != 0) {
+                fail(std::make_exception_ptr(std::runtime_error("WAL " + filename + " ends with a torn record")));
+            }
+            throw std::runtime_error("Can not write WAL " + filename);
+        }
+        data += written;
+        left -= written;
+    }
+    file_size += record.size();
+
+    if (mode == EVERY_COMMIT) {
+        sync();
+    } else if (mode == INTERVAL) {
+        std::lock_guard<std::mutex> guard(sync_mutex);
+        unsynced = true;
+    }
+}
 
-        memtable.insert(kv_pair{key, value});
+/**
+ * Reserve disk blocks ahead of the writes, so appending and syncing only
+ * has to update the file size and not allocate blocks. The file size is
+ * kept, recovery never sees the reserved space. File systems without
+ * fallocate simply allocate on write, any other error like a full disk
+ * fails the append before anything is written.
+ */
+void write_ahead_log::preallocate(uint64_t end) {
+    if (end <= preallocated_until or not can_preallocate) {
+        return;
     }
 
-    wal_tmp.close();
-}
\ No newline at end of file
+    uint64_t new_end = (end + PREALLOCATE_SIZE - 1) / PREALLOCATE_SIZE * PREALLOCATE_SIZE;
+    int result;
+    do {
+        result = ::fallocate(fd, FALLOC_FL_KEEP_SIZE, (off_t) preallocated_until, (off_t) (new_end - preallocated_until));
+    } while (result != 0 and errno == EINTR);
+
+    if (result != 0) {
+        if (errno != EOPNOTSUPP and errno != ENOSYS) {
+            throw std::runtime_error("Can not preallocate WAL " + filename);
+        }
+        can_preallocate = false;
+        return;
+    }
+    preallocated_until = new_end;
+}
+
+void write_ahead_log::truncate(uint64_t size) {
+    if (::ftruncate(fd, (off_t) size) != 0) {
+        throw std::runtime_error("Can not truncate WAL " + filename);
+    }
+    file_size = size;
+}
@@ -2,28 +2,100 @@
 #define WAL_H
 
 #include "../utils/types.hpp"
-#include "../red_black_tree/red_black.hpp"
-#include <iostream>
-#include <fstream>
+#include "../memtable/skiplist_memtable.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <mutex>
 #include <string>
-#include <filesystem>
+#include <string_view>
+#include <thread>
 
+/**
+ * Binary append-only log of the writes to one memtable.
+ * Every record is framed as
+ *   fixed32 masked crc32c | fixed32 payload length | payload
+ * where the crc covers the length and the payload. The payload starts with
+ * the fixed64 sequence number of its first entry and holds one or more
+ * entries of type byte | varint key length | varint value length | key |
+ * value, which have consecutive sequence numbers.
+ * A record is written with a single write(2), so after a crash the log ends
+ * with complete records followed by at most one torn record. Recovery
+ * applies a record completely or not at all. A write that fails is cut off
+ * again, so later records never follow a torn one. If that is not possible,
+ * or a sync fails, the log refuses all further appends.
+ * In INTERVAL mode a background thread syncs the log every sync interval
+ * while there are unsynced records.
+ */
 class write_ahead_log {
-    
+
     public:
-        write_ahead_log(const std::string& filename);
+        enum sync_mode {
+            // Leave writing back to the OS, survives process crashes only.
+            NONE,
+            // fdatasync in the background every sync_interval_ms.
+            INTERVAL,
+            // fdatasync every record before the write returns.
+            EVERY_COMMIT
+        };
+
+        explicit write_ahead_log(const std::string& filename, sync_mode mode = NONE, uint64_t sync_interval_ms = 0);
+
+        write_ahead_log(const write_ahead_log&) = delete;
+
+        write_ahead_log& operator=(const write_ahead_log&) = delete;
 
         ~write_ahead_log();
 
-        void append(const std::string& content);
+        void append(std::string_view payload);
+
+        static void begin_payload(std::string& payload, uint64_t first_sequence);
+
+        static void encode_entry(std::string& payload, const kv_pair& pair);
+
+        void sync();
+
+        std::exception_ptr get_failure();
 
         void clear();
 
-        void repopulate_memtable(red_black_tree& memtable) const;
+        void remove();
+
+        uint64_t repopulate_memtable(skiplist_memtable& memtable);
 
     private:
+        static const uint64_t HEADER_SIZE{8};
+        // The file is extended in steps of this size ahead of the writes.
+        static const uint64_t PREALLOCATE_SIZE{8 * 1024 * 1024};
+
         std::string filename;
-        std::ofstream wal_file;
+        int fd{-1};
+        sync_mode mode;
+        std::chrono::milliseconds sync_interval;
+
+        uint64_t file_size{0};
+        uint64_t preallocated_until{0};
+        bool can_preallocate{true};
+
+        // Guards the state shared with the sync thread.
+        std::mutex sync_mutex;
+        std::condition_variable sync_cv;
+        bool unsynced{false};
+        bool stop_syncing{false};
+        // Set once the log can not be appended to safely anymore.
+        std::exception_ptr failure;
+        std::thread sync_thread;
+
+        void sync_periodically();
+
+        void stop_sync_thread();
+
+        void fail(std::exception_ptr error);
+
+        void preallocate(uint64_t end);
+
+        void truncate(uint64_t size);
 };
 
-#endif // WAL_H
\ No newline at end of file
+#endif // WAL_H
@@ -0,0 +1,133 @@
+#include "../src/lsm_tree/lsm_tree.hpp"
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * A range delete has to hide the keys it covers wherever the tombstone and
+ * the keys live: both in the memtable, the tombstone in the memtable over
+ * keys in an SST, and both in SSTs. A bottommost compaction drops the
+ * tombstone together with the versions it deletes, and the keys stay
+ * deleted after a reopen.
+ */
+static bool wait_until(const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (not done()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+static size_t count_ssts(const std::filesystem::path& segment_dir) {
+    size_t ssts{0};
+    if (std::filesystem::exists(segment_dir)) {
+        for (const auto& file : std::filesystem::directory_iterator(segment_dir)) {
+            ssts += file.path().extension() == ".sst";
+        }
+    }
+    return ssts;
+}
+
+// 80 MBs of other keys, more than the 64 MBs memtable.
+static void fill_memtable(lsm_tree& tree, const std::string& prefix) {
+    for (int i = 0; i < 80; ++i) {
+        tree.put(std::string(prefix).append(std::to_string(i)), std::string(1024 * 1024, (char) ('a' + i % 26)));
+    }
+}
+
+static std::string make_key(int i) {
+    std::string digits = std::to_string(i);
+    return std::string("r").append(3 - digits.size(), '0').append(digits);
+}
+
+// Keys r010 to r019 are deleted, r015 is written again after the delete.
+static bool check(lsm_tree& tree, const std::string& stage) {
+    for (int i = 0; i < 100; ++i) {
+        std::string expected = i == 15 ? "new" : i >= 10 and i < 20 ? "" : "value";
+        if (tree.get(make_key(i)) != expected) {
+            std::cerr << "key " << make_key(i) << " is wrong with " << stage << std::endl;
+            return false;
+        }
+    }
+
+    std::vector<std::string> scanned;
+    lsm_iterator it = tree.new_iterator();
+    for (it.seek("r008"); it.valid() and scanned.size() < 4; it.next()) {
+        scanned.emplace_back(it.key());
+    }
+    if (scanned != std::vector<std::string>{"r008", "r009", "r015", "r020"}) {
+        std::cerr << "a scan does not skip the deleted range with " << stage << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static int run(const std::filesystem::path& directory) {
+    lsm_options options;
+    options.directory = directory.string() + "/";
+    options.compaction_style = compaction_policy::LEVELED;
+
+    {
+        lsm_tree tree(options);
+        tree.put("m1", "value");
+        tree.put("m2", "value");
+        tree.delete_range("m0", "m9");
+        if (tree.get("m1") != "" or tree.get("m2") != "") {
+            std::cerr << "a range delete in the memtable does not hide its keys" << std::endl;
+            return 1;
+        }
+
+        for (int i = 0; i < 100; ++i) {
+            tree.put(make_key(i), "value");
+        }
+        fill_memtable(tree, "a");
+        if (not wait_until([&] { return count_ssts(directory / "segments") >= 1; })) {
+            std::cerr << "the memtable was not flushed" << std::endl;
+            return 1;
+        }
+
+        tree.delete_range("r010", "r020");
+        tree.put("r015", "new");
+        if (not check(tree, "the tombstone in the memtable")) {
+            return 1;
+        }
+
+        fill_memtable(tree, "b");
+        if (not wait_until([&] { return tree.get_compaction_stats().compactions >= 1; })) {
+            std::cerr << "the SSTs were not compacted" << std::endl;
+            return 1;
+        }
+        if (not check(tree, "the tombstone compacted")) {
+            return 1;
+        }
+
+        // The old version of r015 is hidden by the new one, not deleted.
+        compaction_stats stats = tree.get_compaction_stats();
+        if (stats.bottommost_compactions == 0 or stats.dropped_tombstones == 0 or stats.dropped_versions < 9) {
+            std::cerr << "the bottommost compaction did not drop the tombstone and the versions it deletes" << std::endl;
+            return 1;
+        }
+        tree.close();
+    }
+
+    lsm_tree tree(options);
+    if (not check(tree, "a reopened tree") or tree.get("m1") != "") {
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "delete_range_test";
+    std::filesystem::remove_all(directory);
+    int result = run(directory);
+    std::filesystem::remove_all(directory);
+    return result;
+}
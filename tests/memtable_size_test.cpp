@@ -0,0 +1,58 @@
+#include "../src/lsm_tree/lsm_tree.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+
+/**
+ * Overwriting a single key has to fill the memtable as well, since every
+ * version stays in it until the flush. Writing one key past the memtable
+ * size must switch the memtable and flush it to an SST.
+ */
+static bool has_segment(const std::filesystem::path& segment_dir) {
+    if (not std::filesystem::exists(segment_dir)) {
+        return false;
+    }
+    for (const auto& file : std::filesystem::directory_iterator(segment_dir)) {
+        if (file.path().extension() == ".sst") {
+            return true;
+        }
+    }
+    return false;
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "memtable_size_test";
+    std::filesystem::remove_all(directory);
+
+    lsm_options options;
+    options.directory = directory.string() + "/";
+    bool switched{false};
+    std::string last;
+    {
+        lsm_tree tree(options);
+        // 80 MBs of versions of one key, more than the 64 MBs memtable.
+        for (int i = 0; i < 80; ++i) {
+            last = std::string(1024 * 1024, (char) ('a' + i % 26)) + std::to_string(i);
+            tree.put("key", last);
+        }
+
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+        while (not (switched = has_segment(directory / "segments")) and std::chrono::steady_clock::now() < deadline) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+
+        if (tree.get("key") != last) {
+            std::cerr << "the newest version of the key was lost" << std::endl;
+            return 1;
+        }
+    }
+    std::filesystem::remove_all(directory);
+
+    if (not switched) {
+        std::cerr << "the memtable was not switched after overwriting one key past its size" << std::endl;
+        return 1;
+    }
+    return 0;
+}
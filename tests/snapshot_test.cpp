@@ -0,0 +1,104 @@
+#include "../src/lsm_tree/lsm_tree.hpp"
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
+
+/**
+ * A snapshot has to keep reading the versions it was taken at, while the
+ * key is overwritten and deleted, the memtable holding the old version is
+ * flushed and the SSTs are compacted.
+ */
+static bool wait_until(const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (not done()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+static size_t count_ssts(const std::filesystem::path& segment_dir) {
+    size_t ssts{0};
+    if (std::filesystem::exists(segment_dir)) {
+        for (const auto& file : std::filesystem::directory_iterator(segment_dir)) {
+            ssts += file.path().extension() == ".sst";
+        }
+    }
+    return ssts;
+}
+
+// 80 MBs of other keys, more than the 64 MBs memtable.
+static void fill_memtable(lsm_tree& tree, const std::string& prefix) {
+    for (int i = 0; i < 80; ++i) {
+        tree.put(prefix + std::to_string(i), std::string(1024 * 1024, (char) ('a' + i % 26)));
+    }
+}
+
+static bool check(lsm_tree& tree, const snapshot* snap, const std::string& stage) {
+    if (tree.get("key", snap) != "v1" or tree.get("gone", snap) != "old") {
+        std::cerr << "the snapshot does not read its versions after " << stage << std::endl;
+        return false;
+    }
+
+    lsm_iterator it = tree.new_iterator(lsm_iterator::FORWARD, snap);
+    it.seek("gone");
+    if (not it.valid() or it.key() != "gone" or it.value() != "old") {
+        std::cerr << "an iterator on the snapshot does not see its versions after " << stage << std::endl;
+        return false;
+    }
+    return true;
+}
+
+static int run(const std::filesystem::path& directory) {
+    lsm_options options;
+    options.directory = directory.string() + "/";
+    options.compaction_style = compaction_policy::LEVELED;
+    lsm_tree tree(options);
+
+    tree.put("key", "v1");
+    tree.put("gone", "old");
+    std::shared_ptr<const snapshot> snap = tree.get_snapshot();
+    tree.put("key", "v2");
+    tree.remove("gone");
+    if (not check(tree, snap.get(), "an overwrite")) {
+        return 1;
+    }
+
+    fill_memtable(tree, "a");
+    if (not wait_until([&] { return count_ssts(directory / "segments") >= 1; })) {
+        std::cerr << "the memtable was not flushed" << std::endl;
+        return 1;
+    }
+    if (not check(tree, snap.get(), "a flush")) {
+        return 1;
+    }
+
+    tree.put("key", "v3");
+    fill_memtable(tree, "b");
+    if (not wait_until([&] { return tree.get_compaction_stats().compactions >= 1; })) {
+        std::cerr << "the SSTs were not compacted" << std::endl;
+        return 1;
+    }
+    if (not check(tree, snap.get(), "a compaction")) {
+        return 1;
+    }
+
+    if (tree.get("key") != "v3" or tree.get("gone") != "") {
+        std::cerr << "reads without the snapshot do not see the newest versions" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "snapshot_test";
+    std::filesystem::remove_all(directory);
+    int result = run(directory);
+    std::filesystem::remove_all(directory);
+    return result;
+}
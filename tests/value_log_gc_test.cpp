@@ -0,0 +1,133 @@
+#include "../src/lsm_tree/lsm_tree.hpp"
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iostream>
+#include <set>
+#include <string>
+#include <thread>
+
+/**
+ * Once a compaction drops most of the values of a value log file,
+ * collect_value_log_garbage() has to rewrite the SSTs pointing into it,
+ * move the live values to a new file and delete the old one. The values
+ * stay readable, also after the tree is opened again.
+ */
+static bool wait_until(const std::function<bool()>& done) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(60);
+    while (not done()) {
+        if (std::chrono::steady_clock::now() >= deadline) {
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return true;
+}
+
+static std::set<std::string> list_files(const std::filesystem::path& dir, const std::string& extension) {
+    std::set<std::string> files;
+    if (std::filesystem::exists(dir)) {
+        for (const auto& file : std::filesystem::directory_iterator(dir)) {
+            if (file.path().extension() == extension) {
+                files.insert(file.path().filename().string());
+            }
+        }
+    }
+    return files;
+}
+
+static std::string make_key(int i) {
+    return std::string("k").append(std::to_string(i));
+}
+
+static std::string make_value(int i, int generation) {
+    return std::string(100 * 1024, (char) ('a' + (i + generation) % 26)).append(std::to_string(i));
+}
+
+// The first 525 keys are written twice.
+static bool check(lsm_tree& tree, const std::string& stage) {
+    for (int i = 0; i < 700; ++i) {
+        if (tree.get(make_key(i)) != make_value(i, i < 525 ? 1 : 0)) {
+            std::cerr << "the value of " << make_key(i) << " is wrong " << stage << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static int run(const std::filesystem::path& directory) {
+    lsm_options options;
+    options.directory = directory.string() + "/";
+    options.compaction_style = compaction_policy::LEVELED;
+    options.value_log_threshold = 1000;
+    std::set<std::string> collected;
+
+    {
+        lsm_tree tree(options);
+        // 70 MBs of values, the first memtable is flushed into its own
+        // value log file.
+        for (int i = 0; i < 700; ++i) {
+            tree.put(make_key(i), make_value(i, 0));
+        }
+        if (not wait_until([&] { return not list_files(directory / "segments", ".sst").empty(); })) {
+            std::cerr << "the memtable was not flushed" << std::endl;
+            return 1;
+        }
+
+        // Overwrite three quarters of the first file, then flush again.
+        for (int i = 0; i < 525; ++i) {
+            tree.put(make_key(i), make_value(i, 1));
+        }
+        for (int i = 0; i < 200; ++i) {
+            tree.put(std::string("z").append(std::to_string(i)), make_value(i, 2));
+        }
+        if (not wait_until([&] { return tree.get_compaction_stats().compactions >= 1; })) {
+            std::cerr << "the SSTs were not compacted" << std::endl;
+            return 1;
+        }
+
+        std::set<std::string> before = list_files(directory / "vlog", ".vlog");
+        if (tree.collect_value_log_garbage() == 0) {
+            std::cerr << "no SST pointing into the mostly stale value log file was rewritten" << std::endl;
+            return 1;
+        }
+        auto is_collected = [&] {
+            std::set<std::string> after = list_files(directory / "vlog", ".vlog");
+            collected.clear();
+            for (const std::string& file : before) {
+                if (not after.contains(file)) {
+                    collected.insert(file);
+                }
+            }
+            return not collected.empty();
+        };
+        if (not wait_until(is_collected)) {
+            std::cerr << "the stale value log file was not deleted" << std::endl;
+            return 1;
+        }
+        if (not check(tree, "after the garbage collection")) {
+            return 1;
+        }
+        tree.close();
+    }
+
+    lsm_tree tree(options);
+    if (not check(tree, "after a reopen")) {
+        return 1;
+    }
+    for (const std::string& file : collected) {
+        if (std::filesystem::exists(directory / "vlog" / file)) {
+            std::cerr << "the collected value log file " << file << " is back after a reopen" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "value_log_gc_test";
+    std::filesystem::remove_all(directory);
+    int result = run(directory);
+    std::filesystem::remove_all(directory);
+    return result;
+}
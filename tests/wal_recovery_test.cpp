@@ -0,0 +1,108 @@
+#include "../src/lsm_tree/lsm_tree.hpp"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+/**
+ * Writes that only reached the WAL have to be replayed when the tree is
+ * opened again. A torn record at the end of the log is dropped together
+ * with everything after it, and the log is cut there so the records
+ * written after the reopen are replayed by the next one.
+ */
+static std::filesystem::path newest_wal(const std::filesystem::path& wal_dir) {
+    std::filesystem::path newest;
+    uint64_t newest_number{0};
+    for (const auto& file : std::filesystem::directory_iterator(wal_dir)) {
+        if (file.path().extension() != ".log") {
+            continue;
+        }
+        uint64_t number = std::stoull(file.path().stem().string());
+        if (newest.empty() or number > newest_number) {
+            newest = file.path();
+            newest_number = number;
+        }
+    }
+    return newest;
+}
+
+static std::string make_key(const std::string& prefix, int i) {
+    return std::string(prefix).append(std::to_string(i));
+}
+
+static bool check_keys(lsm_tree& tree, const std::string& prefix, int count, const std::string& stage) {
+    for (int i = 0; i < count; ++i) {
+        std::string expected = prefix == "k" and i == 5 ? "" : make_key("value", i);
+        if (tree.get(make_key(prefix, i)) != expected) {
+            std::cerr << "key " << prefix << i << " was not replayed " << stage << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static int run(const std::filesystem::path& directory) {
+    lsm_options options;
+    options.directory = directory.string() + "/";
+    options.wal_sync_mode = write_ahead_log::EVERY_COMMIT;
+
+    {
+        lsm_tree tree(options);
+        for (int i = 0; i < 100; ++i) {
+            tree.put(make_key("k", i), make_key("value", i));
+        }
+        tree.remove("k5");
+        tree.close();
+    }
+
+    // A header announcing more bytes than follow, as left by a crash in
+    // the middle of a write.
+    std::filesystem::path wal = newest_wal(directory / "wal");
+    uint64_t intact_size = std::filesystem::file_size(wal);
+    {
+        std::ofstream out(wal, std::ios::binary | std::ios::app);
+        const char torn[] = {0x12, 0x34, 0x56, 0x78, 0x00, 0x10, 0x00, 0x00, 'p', 'a', 'r', 't'};
+        out.write(torn, sizeof(torn));
+    }
+
+    {
+        lsm_tree tree(options);
+        if (not check_keys(tree, "k", 100, "before the torn record")) {
+            return 1;
+        }
+        if (std::filesystem::file_size(newest_wal(directory / "wal")) != intact_size) {
+            std::cerr << "the torn record was not cut off the WAL" << std::endl;
+            return 1;
+        }
+        for (int i = 0; i < 10; ++i) {
+            tree.put(make_key("n", i), make_key("value", i));
+        }
+        tree.close();
+    }
+
+    // A record whose checksum does not match is torn as well.
+    wal = newest_wal(directory / "wal");
+    {
+        std::fstream file(wal, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(-1, std::ios::end);
+        file.put('#');
+    }
+
+    lsm_tree tree(options);
+    if (not check_keys(tree, "k", 100, "after a reopen") or not check_keys(tree, "n", 9, "after the reopen")) {
+        return 1;
+    }
+    if (tree.get("n9") != "") {
+        std::cerr << "a record failing its checksum was replayed" << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "wal_recovery_test";
+    std::filesystem::remove_all(directory);
+    int result = run(directory);
+    std::filesystem::remove_all(directory);
+    return result;
+}